@@ -0,0 +1,59 @@
+#!/usr/bin/env bash
+# SPDX-License-Identifier: GPL-3.0-only
+#
+# Generate per-degree fan duty tables. Input is the preprocessed fan curves,
+# each as "__fan_lut__(NAME, INTERPOLATE, TEMP:DUTY, ...)" with duty in
+# percent. Output is a header defining NAME_FAN_LUT_TEMP, the temperature of
+# the first entry, and NAME_FAN_LUT, the PWM duty for each degree up to the
+# last point. Duties are calculated the same way the firmware used to walk
+# the fan points at runtime.
+
+set -e
+
+curves="$(tr '\n' ' ' | grep -oE '__fan_lut__\([^)]*\)' || true)"
+if [ -z "${curves}" ]; then
+    echo "$0: no fan curves found" >&2
+    exit 1
+fi
+
+echo "// Generated by scripts/fan_lut.sh"
+
+while read -r curve; do
+    args="${curve#__fan_lut__(}"
+    args="${args%)}"
+    IFS=, read -r -a fields <<< "${args// /}"
+
+    name="${fields[0]}"
+    interpolate="$((fields[1] != 0))"
+    temps=()
+    duties=()
+    for point in "${fields[@]:2}"; do
+        if [ -n "${point}" ]; then
+            temps+=("$((${point%%:*}))")
+            # PWM_DUTY from board/fan.h
+            duties+=("$((((${point#*:}) * 255 + 99) / 100))")
+        fi
+    done
+
+    lut=()
+    for ((temp = temps[0]; temp <= temps[-1]; temp++)); do
+        for ((i = 0; i < ${#temps[@]}; i++)); do
+            if ((temp == temps[i])); then
+                duty="${duties[i]}"
+                break
+            elif ((temp < temps[i])); then
+                if ((interpolate)); then
+                    duty="$((duties[i - 1] + ((temp - temps[i - 1]) * (duties[i] - duties[i - 1])) / (temps[i] - temps[i - 1])))"
+                else
+                    duty="${duties[i - 1]}"
+                fi
+                break
+            fi
+        done
+        lut+=("$((duty & 0xFF))")
+    done
+
+    echo
+    echo "#define ${name}_FAN_LUT_TEMP ${temps[0]}"
+    echo "#define ${name}_FAN_LUT { $(IFS=,; echo "${lut[*]}" | sed 's/,/, /g') }"
+done <<< "${curves}"
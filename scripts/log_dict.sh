@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+# SPDX-License-Identifier: GPL-3.0-only
+#
+# Generate the dictionary for tokenized logging. Each argument is a source
+# file with its ID and log level, as ID=LEVEL=PATH. CC and CFLAGS must be set
+# as when compiling, without -DLEVEL, and with CFLAGS quoted the same way as
+# in the compiler command line.
+# Output is one "ID:INDEX<tab>FORMAT" line per call site, where INDEX is the
+# __COUNTER__ value of the call site and FORMAT is its C string literal.
+
+set -e
+
+# Board curves and similar values are quoted, so split CFLAGS like the shell
+eval "cflags=(${CFLAGS})"
+
+for arg in "$@"; do
+    id="${arg%%=*}"
+    arg="${arg#*=}"
+    level="${arg%%=*}"
+    src="${arg#*=}"
+    # shellcheck disable=SC2086
+    ${CC} "${cflags[@]}" -DLEVEL="${level}" -DLOG_FILE="${id}" -DLOG_DICT -E "${src}" |
+        grep -oE '__log_dict__\( *[0-9]+ *, *[0-9]+ *, *("([^"\\]|\\.)*" *)+' |
+        sed -E 's/^__log_dict__\( *([0-9]+) *, *([0-9]+) *, *(.*[^ ]) *$/\1:\2\t\3/'
+done | sort -t: -k1,1n -k2,2n
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <arch/async.h>
+#include <arch/time.h>
+
+void async_delay(struct Async * async, uint8_t step, uint16_t ms) {
+    // The current millisecond has already partly passed, so wait one more
+    // to guarantee the minimum
+    async->until = time_get_fast() + ms + 1;
+    async->step = step;
+}
+
+void async_cancel(struct Async * async) {
+    async->step = 0;
+}
+
+uint8_t async_poll(struct Async * async) {
+    uint8_t step = async->step;
+    if (step == 0) {
+        return 0;
+    }
+
+    // Signed difference handles the time wrapping
+    if ((int16_t)(time_get_fast() - async->until) < 0) {
+        return 0;
+    }
+
+    async->step = 0;
+    return step;
+}
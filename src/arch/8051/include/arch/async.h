@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef _ARCH_ASYNC_H
+#define _ARCH_ASYNC_H
+
+#include <stdint.h>
+
+// Step of a task that waits between steps without blocking the main loop.
+// Waits of a few microseconds should still use delay_us.
+struct Async {
+    // Step to run once the wait is over, 0 if idle
+    uint8_t step;
+    // Time when the wait is over, from time_get_fast
+    uint16_t until;
+};
+
+// Continue with `step` after at least `ms` milliseconds, up to 32 seconds
+void async_delay(struct Async * async, uint8_t step, uint16_t ms);
+// Stop waiting, so no step runs
+void async_cancel(struct Async * async);
+// Returns the step to run now, or 0 if idle or still waiting. The step is
+// only returned once, and can call async_delay to continue with another
+uint8_t async_poll(struct Async * async);
+
+#endif // _ARCH_ASYNC_H
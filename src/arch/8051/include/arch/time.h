@@ -5,7 +5,23 @@
 
 #include <stdint.h>
 
+// Timer 0 ticks per millisecond, each tick is 12 / 9.2 MHz or ~1.3 us
+#define TIME_TICKS_PER_MS 767
+
 void time_init(void);
+// Milliseconds since init
 uint32_t time_get(void);
+// Low 16 bits of time_get, without disabling interrupts. Only for intervals
+// shorter than 65 seconds
+uint16_t time_get_fast(void);
+// Timer 0 ticks since init, wraps after about 93 minutes
+uint32_t time_get_ticks(void);
+// Microseconds since init, wraps after about 71 minutes
+//
+// NOTE: A read taken while the timer 0 interrupt is pending counts the ticks
+// past the millisecond boundary, but the interrupt then reloads the timer, so
+// a following read may be a few ticks earlier. Unsigned deltas of reads this
+// close together show as a wrap of about 71 minutes.
+uint32_t time_get_us(void);
 
 #endif // _ARCH_TIME_H
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef _ARCH_TIMER_H
+#define _ARCH_TIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Number of software timers that can be added
+#ifndef TIMER_SLOTS
+    #define TIMER_SLOTS 8
+#endif
+
+// Returned by timer_add when all slots are in use
+#define TIMER_NONE 0xFF
+
+// Add a timer that calls `callback` after `interval` ms, and every `interval`
+// ms after that if `periodic` is set. Intervals must be shorter than 32
+// seconds. One-shot timers keep their slot after running, and can be armed
+// again with timer_restart.
+uint8_t timer_add(void (*callback)(void), uint16_t interval, bool periodic);
+// Arm a timer to run `interval` ms from now
+void timer_restart(uint8_t id);
+// Disarm a timer without freeing its slot
+void timer_cancel(uint8_t id);
+// Free a timer slot
+void timer_remove(uint8_t id);
+// Run callbacks of expired timers, at most once per millisecond
+void timer_event(void);
+
+#endif // _ARCH_TIMER_H
@@ -6,6 +6,9 @@
 
 #include <arch/time.h>
 
+// Timer 0 count at the start of each millisecond
+#define TIME_RELOAD 0xFD01
+
 static volatile uint32_t time_overflows = 0;
 
 void timer_0(void) __interrupt(1) {
@@ -15,8 +18,8 @@ void timer_0(void) __interrupt(1) {
     time_overflows++;
 
     // Start timer
-    TH0 = 0xFD;
-    TL0 = 0x01;
+    TH0 = (uint8_t)(TIME_RELOAD >> 8);
+    TL0 = (uint8_t)TIME_RELOAD;
     TR0 = 1;
 }
 
@@ -33,11 +36,56 @@ void time_init(void) __critical {
     // Start timer in mode 1
     // (65536 - 64769) / (9.2 MHz / 12) = ~1 ms interval
     TMOD = (TMOD & 0xF0) | 0x01;
-    TH0 = 0xFD;
-    TL0 = 0x01;
+    TH0 = (uint8_t)(TIME_RELOAD >> 8);
+    TL0 = (uint8_t)TIME_RELOAD;
     TR0 = 1;
 }
 
 uint32_t time_get(void) __critical {
     return time_overflows;
 }
+
+uint16_t time_get_fast(void) {
+    uint16_t time;
+    // Only the timer interrupt writes the count, so a read that matches the
+    // following read was not torn by it
+    do {
+        time = (uint16_t)time_overflows;
+    } while (time != (uint16_t)time_overflows);
+    return time;
+}
+
+// Read the millisecond count and the ticks elapsed in the current millisecond
+static uint32_t time_get_parts(uint16_t * ticks) __critical {
+    uint32_t time = time_overflows;
+
+    uint8_t high;
+    uint8_t low;
+    do {
+        high = TH0;
+        low = TL0;
+    } while (high != TH0);
+    uint16_t count = ((uint16_t)high << 8) | low;
+
+    if (count < TIME_RELOAD) {
+        // Timer overflowed, but the interrupt cannot run until this returns
+        time++;
+        *ticks = count;
+    } else {
+        *ticks = count - TIME_RELOAD;
+    }
+    return time;
+}
+
+uint32_t time_get_ticks(void) {
+    uint16_t ticks;
+    uint32_t time = time_get_parts(&ticks);
+    return time * TIME_TICKS_PER_MS + ticks;
+}
+
+uint32_t time_get_us(void) {
+    uint16_t ticks;
+    uint32_t time = time_get_parts(&ticks);
+    // Ticks are 12 / 9.2 MHz, or 30 / 23 us
+    return time * 1000 + ((uint32_t)ticks * 30) / 23;
+}
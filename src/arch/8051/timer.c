@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Software timers driven by the main loop, using the millisecond count from
+// time.c
+
+#include <arch/time.h>
+#include <arch/timer.h>
+#include <common/macro.h>
+
+#define TIMER_FLAG_USED BIT(0)
+#define TIMER_FLAG_ARMED BIT(1)
+#define TIMER_FLAG_PERIODIC BIT(2)
+
+struct Timer {
+    void (*callback)(void);
+    uint16_t interval;
+    uint16_t expires;
+    uint8_t flags;
+};
+
+static struct Timer timers[TIMER_SLOTS];
+
+// Time when timer_event last checked for expired timers
+static uint16_t timer_last = 0;
+
+uint8_t timer_add(void (*callback)(void), uint16_t interval, bool periodic) {
+    uint8_t id;
+    for (id = 0; id < TIMER_SLOTS; id++) {
+        struct Timer * timer = &timers[id];
+        if (!(timer->flags & TIMER_FLAG_USED)) {
+            timer->callback = callback;
+            timer->interval = interval;
+            timer->flags = TIMER_FLAG_USED;
+            if (periodic) {
+                timer->flags |= TIMER_FLAG_PERIODIC;
+            }
+            timer_restart(id);
+            return id;
+        }
+    }
+    return TIMER_NONE;
+}
+
+void timer_restart(uint8_t id) {
+    if (id < TIMER_SLOTS) {
+        struct Timer * timer = &timers[id];
+        timer->expires = time_get_fast() + timer->interval;
+        timer->flags |= TIMER_FLAG_ARMED;
+    }
+}
+
+void timer_cancel(uint8_t id) {
+    if (id < TIMER_SLOTS) {
+        timers[id].flags &= ~TIMER_FLAG_ARMED;
+    }
+}
+
+void timer_remove(uint8_t id) {
+    if (id < TIMER_SLOTS) {
+        timers[id].flags = 0;
+    }
+}
+
+void timer_event(void) {
+    uint16_t time = time_get_fast();
+    if (time == timer_last) {
+        return;
+    }
+    timer_last = time;
+
+    uint8_t id;
+    for (id = 0; id < TIMER_SLOTS; id++) {
+        struct Timer * timer = &timers[id];
+        if (!(timer->flags & TIMER_FLAG_ARMED)) {
+            continue;
+        }
+
+        // Signed difference handles the time wrapping
+        if ((int16_t)(time - timer->expires) < 0) {
+            continue;
+        }
+
+        if (timer->flags & TIMER_FLAG_PERIODIC) {
+            // Keep the period if the main loop was late
+            timer->expires += timer->interval;
+            if ((int16_t)(time - timer->expires) >= 0) {
+                timer->expires = time + timer->interval;
+            }
+        } else {
+            timer->flags &= ~TIMER_FLAG_ARMED;
+        }
+
+        timer->callback();
+    }
+}
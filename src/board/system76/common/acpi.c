@@ -2,6 +2,7 @@
 
 #include <board/acpi.h>
 #include <board/battery.h>
+#include <board/boot.h>
 #include <board/dgpu.h>
 #include <board/gpio.h>
 #include <board/kbled.h>
@@ -194,6 +195,9 @@ void acpi_write(uint8_t addr, uint8_t data) {
 
         case 0x68:
             acpi_ecos = (enum EcOs)data;
+            if (acpi_ecos != EC_OS_NONE) {
+                boot_mark(BOOT_MARK_ACPI_OS);
+            }
             break;
 
         case 0xBC:
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <arch/time.h>
+#include <board/boot.h>
+#include <common/macro.h>
+#include <ec/ec.h>
+
+static uint32_t boot_marks[BOOT_MARK_COUNT];
+static uint8_t boot_marks_valid = 0;
+
+void boot_mark(enum BootMark mark) {
+    if (mark == BOOT_MARK_POWER_BUTTON) {
+        // Start a new measurement, including POST codes
+        boot_marks_valid = 0;
+        ec_post_clear();
+    }
+
+    boot_marks[mark] = time_get();
+    boot_marks_valid |= BIT(mark);
+}
+
+bool boot_mark_get(enum BootMark mark, uint32_t * time) {
+    if (boot_marks_valid & BIT(mark)) {
+        *time = boot_marks[mark];
+        return true;
+    }
+    return false;
+}
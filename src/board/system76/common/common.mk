@@ -7,7 +7,38 @@
 # 3 - INFO
 # 4 - DEBUG
 # 5 - TRACE
-CFLAGS+=-DLEVEL=4
+LEVEL?=4
+
+# Set log level of individual modules, from board.mk or the command line
+LEVEL_ACPI?=$(LEVEL)
+LEVEL_BATTERY?=$(LEVEL)
+LEVEL_ESPI?=$(LEVEL)
+LEVEL_KBC?=$(LEVEL)
+LEVEL_KBSCAN?=$(LEVEL)
+LEVEL_PECI?=$(LEVEL)
+LEVEL_PMC?=$(LEVEL)
+LEVEL_POWER?=$(LEVEL)
+
+# Sources of each module, as SOURCE_PATTERN=MODULE
+LOG_MODULES=\
+	src/board/system76/common/acpi.c=ACPI \
+	src/board/system76/common/battery.c=BATTERY \
+	src/board/system76/common/charger/%=BATTERY \
+	src/board/system76/common/espi.c=ESPI \
+	src/ec/ite/espi.c=ESPI \
+	src/board/system76/common/kbc.c=KBC \
+	src/board/system76/common/kbscan.c=KBSCAN \
+	src/board/system76/common/peci.c=PECI \
+	src/board/system76/common/pmc.c=PMC \
+	src/board/system76/common/power.c=POWER
+
+# Log level of a source, from its module or LEVEL
+log_level = $(or $(firstword $(foreach module,$(LOG_MODULES),$(if $(filter $(firstword $(subst =, ,$(module))),$(1)),$(LEVEL_$(lastword $(subst =, ,$(module))))))),$(LEVEL))
+
+# Log level of the object being compiled, evaluated when it is compiled
+LOG_LEVEL=$(LEVEL)
+CFLAGS+=-DLEVEL=$(LOG_LEVEL)
+$(BUILD)/%.rel: LOG_LEVEL=$(call log_level,$<)
 
 # Uncomment to enable debug logging over keyboard parallel port
 #CFLAGS+=-DPARALLEL_DEBUG
@@ -15,6 +46,33 @@ CFLAGS+=-DLEVEL=4
 # Uncomment to enable I2C debug on 0x76
 #CFLAGS+=-DI2C_DEBUGGER=0x76
 
+# Set to 1 to emit TRACE and DEBUG output as tokens, which are decoded by
+# ectool using the dictionary generated at $(BUILD)/log.dict
+LOG_TOKENS?=0
+ifeq ($(LOG_TOKENS),1)
+CFLAGS+=-DLOG_TOKENS
+
+# File ID of a source, from its position in the sorted source list
+log_file = $(words $(call log_file_,$(1),$(sort $(SRC))))
+log_file_ = $(if $(2),x $(if $(filter $(1),$(firstword $(2))),,$(call log_file_,$(1),$(wordlist 2,$(words $(2)),$(2)))))
+
+# Evaluated when each object is compiled, when SRC is complete
+$(BUILD)/%.rel: CFLAGS+=-DLOG_FILE=$(call log_file,$<)
+
+# Generate log dictionary from all sources, each at the log level it was
+# compiled with so the same call sites are counted
+all: $(BUILD)/log.dict
+$(BUILD)/log.dict: $(BUILD)/ec.ihx
+	@mkdir -p $(@D)
+	CC="$(CC)" CFLAGS='$(filter-out -DLEVEL=%,$(CFLAGS))' ./scripts/log_dict.sh \
+		$(foreach src,$(sort $(SRC)),$(call log_file,$(src))=$(call log_level,$(src))=$(src)) > $@
+endif
+
+# Set to 1 to measure the duration of each main loop task, which can be read
+# with `ectool profile`
+PROFILE?=0
+CFLAGS+=-DPROFILE=$(PROFILE)
+
 # Set external programmer
 PROGRAMMER=$(wildcard /dev/serial/by-id/usb-Arduino*)
 
@@ -53,9 +111,16 @@ include $(SYSTEM76_COMMON_DIR)/scratch/scratch.mk
 # Add scratch ROM for flash access
 include $(SYSTEM76_COMMON_DIR)/flash/flash.mk
 
+# Generate per-degree fan duty tables from the board's fan curves
+FAN_LUT_SRC=$(SYSTEM76_COMMON_DIR)/fan_lut/fan_lut.c
+$(BUILD)/include/fan_lut.h: $(FAN_LUT_SRC) $(SYSTEM76_COMMON_DIR)/include/board/fan.h $(BOARD_DIR)/board.mk scripts/fan_lut.sh
+	@mkdir -p $(@D)
+	$(CC) $(CFLAGS) -E $(FAN_LUT_SRC) | ./scripts/fan_lut.sh > $@
+INCLUDE+=$(BUILD)/include/fan_lut.h
+
 console_internal:
 	cargo build --manifest-path tool/Cargo.toml --release
-	sudo tool/target/release/system76_ectool console
+	sudo tool/target/release/system76_ectool console $(if $(filter 1,$(LOG_TOKENS)),--dictionary $(BUILD)/log.dict)
 
 console_external:
 	sudo test -c "$(PROGRAMMER)"
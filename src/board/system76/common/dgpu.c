@@ -12,48 +12,84 @@
 #include <common/macro.h>
 #include <ec/i2c.h>
 #include <ec/pwm.h>
+#include <fan_lut.h>
 
 // Fan speed is the lowest requested over HEATUP seconds
 #ifndef BOARD_DGPU_HEATUP
     #define BOARD_DGPU_HEATUP 4
 #endif
 
-static uint8_t FAN_HEATUP[BOARD_DGPU_HEATUP] = { 0 };
+static struct FanWindowEntry FAN_HEATUP_ENTRIES[BOARD_DGPU_HEATUP] = { 0 };
+static struct FanWindow FAN_HEATUP = {
+    .entries = FAN_HEATUP_ENTRIES,
+    .size = ARRAY_SIZE(FAN_HEATUP_ENTRIES),
+    .head = 0,
+    .len = 1,
+    .time = 1,
+};
 
 // Fan speed is the highest HEATUP speed over COOLDOWN seconds
 #ifndef BOARD_DGPU_COOLDOWN
     #define BOARD_DGPU_COOLDOWN 10
 #endif
 
-static uint8_t FAN_COOLDOWN[BOARD_DGPU_COOLDOWN] = { 0 };
+static struct FanWindowEntry FAN_COOLDOWN_ENTRIES[BOARD_DGPU_COOLDOWN] = { 0 };
+static struct FanWindow FAN_COOLDOWN = {
+    .entries = FAN_COOLDOWN_ENTRIES,
+    .size = ARRAY_SIZE(FAN_COOLDOWN_ENTRIES),
+    .head = 0,
+    .len = 1,
+    .time = 1,
+};
+
+// Use the closed loop controller instead of the fan curve
+#ifndef BOARD_DGPU_FAN_PID
+    #define BOARD_DGPU_FAN_PID 0
+#endif
+
+#if BOARD_DGPU_FAN_PID
+    #ifndef BOARD_DGPU_FAN_PID_TARGET
+        #define BOARD_DGPU_FAN_PID_TARGET 75
+    #endif
+    #ifndef BOARD_DGPU_FAN_PID_KP
+        #define BOARD_DGPU_FAN_PID_KP 2048 // 8 duty per degree
+    #endif
+    #ifndef BOARD_DGPU_FAN_PID_KI
+        #define BOARD_DGPU_FAN_PID_KI 64 // 0.25 duty per degree per update
+    #endif
+    #ifndef BOARD_DGPU_FAN_PID_KD
+        #define BOARD_DGPU_FAN_PID_KD 0
+    #endif
+
+// dGPU power is not available to the EC, so there is no feed-forward term
+static struct FanPid FAN_PID = {
+    .target = BOARD_DGPU_FAN_PID_TARGET,
+    .kp = BOARD_DGPU_FAN_PID_KP,
+    .ki = BOARD_DGPU_FAN_PID_KI,
+    .kd = BOARD_DGPU_FAN_PID_KD,
+    .kff = 0,
+    .integral = 0,
+    .last_temp = 0,
+    .valid = false,
+};
+#endif // BOARD_DGPU_FAN_PID
 
 int16_t dgpu_temp = 0;
 
 #define DGPU_TEMP(X) ((int16_t)(X))
 
-#define FAN_POINT(T, D) { .temp = DGPU_TEMP(T), .duty = PWM_DUTY(D) }
-
-// Fan curve with temperature in degrees C, duty cycle in percent
-static struct FanPoint __code FAN_POINTS[] = {
-#ifdef BOARD_DGPU_FAN_POINTS
-    BOARD_DGPU_FAN_POINTS
-#else
-    FAN_POINT(70, 40),
-    FAN_POINT(75, 50),
-    FAN_POINT(80, 60),
-    FAN_POINT(85, 65),
-    FAN_POINT(90, 65)
-#endif
-};
+// Fan curve with duty for each degree C, generated from BOARD_DGPU_FAN_POINTS
+static uint8_t __code FAN_LUT[] = DGPU_FAN_LUT;
 
 static struct Fan __code FAN = {
-    .points = FAN_POINTS,
-    .points_size = ARRAY_SIZE(FAN_POINTS),
-    .heatup = FAN_HEATUP,
-    .heatup_size = ARRAY_SIZE(FAN_HEATUP),
-    .cooldown = FAN_COOLDOWN,
-    .cooldown_size = ARRAY_SIZE(FAN_COOLDOWN),
-    .interpolate = SMOOTH_FANS != 0,
+    .lut = FAN_LUT,
+    .lut_temp = DGPU_TEMP(DGPU_FAN_LUT_TEMP),
+    .lut_size = ARRAY_SIZE(FAN_LUT),
+    .heatup = &FAN_HEATUP,
+    .cooldown = &FAN_COOLDOWN,
+#if BOARD_DGPU_FAN_PID
+    .pid = &FAN_PID,
+#endif
 };
 
 void dgpu_init(void) {
@@ -69,24 +105,31 @@ uint8_t dgpu_get_fan_duty(void) {
         int16_t res = i2c_get(&I2C_DGPU, 0x4F, 0x00, &rlts, 1);
         if (res == 1) {
             dgpu_temp = (int16_t)rlts;
+#if BOARD_DGPU_FAN_PID
+            duty = fan_pid(&FAN, dgpu_temp, 0);
+#else // BOARD_DGPU_FAN_PID
             duty = fan_duty(&FAN, dgpu_temp);
+#endif // BOARD_DGPU_FAN_PID
         } else {
             DEBUG("DGPU temp error: %d\n", res);
             // Default to 50% if there is an error
             dgpu_temp = 0;
             duty = PWM_DUTY(50);
+            fan_pid_reset(&FAN);
         }
     } else {
         // Turn fan off if not in S0 state or GPU power not on
         dgpu_temp = 0;
         duty = PWM_DUTY(0);
+        fan_pid_reset(&FAN);
     }
 
     if (peci_on && fan_max) {
         // Override duty if fans are manually set to maximum
         duty = PWM_DUTY(100);
-    } else {
-        // Apply heatup and cooldown filters to duty
+    } else if (!BOARD_DGPU_FAN_PID) {
+        // Apply heatup and cooldown filters to the fan curve duty, the
+        // controller already has its own integral term
         duty = fan_heatup(&FAN, duty);
         duty = fan_cooldown(&FAN, duty);
     }
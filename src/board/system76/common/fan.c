@@ -14,50 +14,192 @@
 
 #define MIN_SPEED_TO_SMOOTH PWM_DUTY(SMOOTH_FANS_MIN)
 
+#define PID_MIN (((int32_t)MIN_FAN_SPEED) << 8)
+#define PID_MAX (((int32_t)MAX_FAN_SPEED) << 8)
+
+// RPM at full duty for tachometer closed loop control, 0 to drive duty directly
+#ifndef BOARD_FAN_RPM_MAX
+    #define BOARD_FAN_RPM_MAX 0
+#endif
+
+#ifndef BOARD_DGPU_FAN_RPM_MAX
+    #define BOARD_DGPU_FAN_RPM_MAX 0
+#endif
+
+// Tachometer count clock, the 9.2 MHz EC clock divided by 128
+#ifndef BOARD_FAN_TACH_CLOCK
+    #define BOARD_FAN_TACH_CLOCK (9200000UL / 128)
+#endif
+
+// Tachometer pulses per fan revolution
+#ifndef BOARD_FAN_TACH_PULSES
+    #define BOARD_FAN_TACH_PULSES 2
+#endif
+
+// Tachometer count of a fan turning at 1 RPM, divided by the count to get RPM
+#define FAN_TACH_RPM_COUNT ((60UL * BOARD_FAN_TACH_CLOCK) / BOARD_FAN_TACH_PULSES)
+
+// Fans below this speed are considered stopped
+#define FAN_RPM_STALL 100
+// Updates without tachometer pulses before kicking the fan
+#define FAN_RPM_STALL_UPDATES 4
+// Updates at full duty to spin up a stopped fan
+#define FAN_RPM_KICK_UPDATES 2
+
 bool fan_max = false;
 uint8_t last_duty_dgpu = 0;
 uint8_t last_duty_peci = 0;
 
+#if BOARD_FAN_RPM_MAX
+static struct FanRpm FAN_RPM_PECI = {
+    .max = BOARD_FAN_RPM_MAX,
+    .duty = 0,
+    .stall = 0,
+    .kick = 0,
+};
+#endif // BOARD_FAN_RPM_MAX
+
+#if BOARD_DGPU_FAN_RPM_MAX
+static struct FanRpm FAN_RPM_DGPU = {
+    .max = BOARD_DGPU_FAN_RPM_MAX,
+    .duty = 0,
+    .stall = 0,
+    .kick = 0,
+};
+#endif // BOARD_DGPU_FAN_RPM_MAX
+
 void fan_reset(void) {
     // Do not manually set fans to maximum speed
     fan_max = false;
 }
 
-// Get duty cycle based on temperature, adapted from
-// https://github.com/pop-os/system76-power/blob/master/src/fan.rs
+// Get duty cycle based on temperature from the fan curve table, which is
+// generated from the fan points by scripts/fan_lut.sh
 uint8_t fan_duty(const struct Fan * fan, int16_t temp) __reentrant {
-    for (uint8_t i = 0; i < fan->points_size; i++) {
-        const struct FanPoint * cur = &fan->points[i];
-
-        // If exactly the current temp, return the current duty
-        if (temp == cur->temp) {
-            return cur->duty;
-        } else if (temp < cur->temp) {
-            // If lower than first temp, return 0%
-            if (i == 0) {
-                return MIN_FAN_SPEED;
-            } else {
-                const struct FanPoint * prev = &fan->points[i - 1];
-
-                if (fan->interpolate) {
-                    // If in between current temp and previous temp, interpolate
-                    if (temp > prev->temp) {
-                        int16_t dtemp = (cur->temp - prev->temp);
-                        int16_t dduty = ((int16_t)cur->duty) - ((int16_t)prev->duty);
-                        return (uint8_t)(
-                            ((int16_t)prev->duty) +
-                            ((temp - prev->temp) * dduty) / dtemp
-                        );
-                    }
-                } else {
-                    return prev->duty;
-                }
-            }
+    // If lower than first temp, return 0%
+    if (temp < fan->lut_temp) {
+        return MIN_FAN_SPEED;
+    }
+
+    // If higher than last temp, return 100%
+    int16_t index = temp - fan->lut_temp;
+    if (index >= fan->lut_size) {
+        return MAX_FAN_SPEED;
+    }
+
+    return fan->lut[index];
+}
+
+// Get duty cycle from the closed loop controller. Package power in watts is
+// used as a feed-forward term, so load steps are met before the temperature
+// has risen enough for the error terms to respond.
+uint8_t fan_pid(const struct Fan * fan, int16_t temp, int16_t power) __reentrant {
+    struct FanPid * pid = fan->pid;
+    int16_t error = temp - pid->target;
+
+    if (!pid->valid) {
+        pid->last_temp = temp;
+        pid->valid = true;
+    }
+
+    // Derivative is taken on temperature so a target change does not kick
+    int32_t output = ((int32_t)pid->kp * error) +
+        ((int32_t)pid->kd * (temp - pid->last_temp)) +
+        ((int32_t)pid->kff * power);
+    pid->last_temp = temp;
+
+    int32_t integral = pid->integral + ((int32_t)pid->ki * error);
+    if (integral > PID_MAX) {
+        integral = PID_MAX;
+    } else if (integral < -PID_MAX) {
+        integral = -PID_MAX;
+    }
+
+    // Anti-windup: do not integrate further while the output is saturated
+    // in the direction of the error
+    if (((output + integral) > PID_MAX && error > 0) ||
+        ((output + integral) < PID_MIN && error < 0)) {
+        output += pid->integral;
+    } else {
+        pid->integral = integral;
+        output += integral;
+    }
+
+    if (output >= PID_MAX) {
+        return MAX_FAN_SPEED;
+    } else if (output <= PID_MIN) {
+        return MIN_FAN_SPEED;
+    } else {
+        return (uint8_t)(output / 256);
+    }
+}
+
+void fan_pid_reset(const struct Fan * fan) __reentrant {
+    struct FanPid * pid = fan->pid;
+    if (pid) {
+        pid->integral = 0;
+        pid->valid = false;
+    }
+}
+
+// Convert tachometer count to RPM
+uint16_t fan_tach_rpm(uint8_t low, uint8_t high) {
+    uint16_t count = (((uint16_t)high) << 8) | low;
+    if (count <= (uint16_t)(FAN_TACH_RPM_COUNT / 0xFFFFUL)) {
+        // No reading, or too fast to be real
+        return 0;
+    }
+    return (uint16_t)(FAN_TACH_RPM_COUNT / count);
+}
+
+// Get duty cycle that drives the fan to the RPM corresponding to the
+// requested duty, so fans of different units and ages run at the same speed
+uint8_t fan_rpm_control(struct FanRpm * rpm, uint8_t duty, uint16_t measured) __reentrant {
+    if (duty == MIN_FAN_SPEED) {
+        rpm->duty = MIN_FAN_SPEED;
+        rpm->stall = 0;
+        rpm->kick = 0;
+        return MIN_FAN_SPEED;
+    }
+
+    // Kick the fan at full duty when starting or stalled, as low duty may
+    // not be enough to overcome static friction
+    if (rpm->duty == MIN_FAN_SPEED || rpm->stall >= FAN_RPM_STALL_UPDATES) {
+        if (rpm->stall) {
+            DEBUG("Fan stalled at duty %d\n", rpm->duty);
         }
+        rpm->duty = duty;
+        rpm->stall = 0;
+        rpm->kick = FAN_RPM_KICK_UPDATES;
+    }
+
+    if (rpm->kick) {
+        rpm->kick--;
+        return MAX_FAN_SPEED;
+    }
+
+    if (measured < FAN_RPM_STALL) {
+        rpm->stall++;
+        return rpm->duty;
+    }
+    rpm->stall = 0;
+
+    // Move a quarter of the way towards the target each update, using the
+    // nominal RPM per duty as the slope
+    int32_t target = (int32_t)(((uint32_t)duty * rpm->max) / MAX_FAN_SPEED);
+    int32_t error = target - (int32_t)measured;
+    int16_t next = (int16_t)rpm->duty +
+        (int16_t)((error * MAX_FAN_SPEED) / ((int32_t)rpm->max * 4));
+    if (next > MAX_FAN_SPEED) {
+        next = MAX_FAN_SPEED;
+    } else if (next <= MIN_FAN_SPEED) {
+        // Keep the fan driven, a duty of zero restarts the kick
+        next = MIN_FAN_SPEED + 1;
     }
+    rpm->duty = (uint8_t)next;
 
-    // If no point is found, return 100%
-    return MAX_FAN_SPEED;
+    TRACE("Fan target=%d rpm=%d duty=%d\n", (int16_t)target, measured, rpm->duty);
+    return rpm->duty;
 }
 
 void fan_duty_set(uint8_t peci_fan_duty, uint8_t dgpu_fan_duty) __reentrant {
@@ -67,52 +209,87 @@ void fan_duty_set(uint8_t peci_fan_duty, uint8_t dgpu_fan_duty) __reentrant {
     #endif
 
     // set PECI fan duty
+#if BOARD_FAN_RPM_MAX
+    // Smoothed duty sets the RPM target, measured every update
+    last_duty_peci = fan_smooth(last_duty_peci, peci_fan_duty);
+    DCR2 = fan_max ? MAX_FAN_SPEED : fan_rpm_control(
+        &FAN_RPM_PECI,
+        last_duty_peci,
+        fan_tach_rpm(F1TLRR, F1TMRR)
+    );
+#else // BOARD_FAN_RPM_MAX
     if (peci_fan_duty != DCR2) {
         TRACE("PECI fan_duty_raw=%d\n", peci_fan_duty);
         last_duty_peci = peci_fan_duty = fan_smooth(last_duty_peci, peci_fan_duty);
         DCR2 = fan_max ? MAX_FAN_SPEED : peci_fan_duty;
         TRACE("PECI fan_duty_smoothed=%d\n", peci_fan_duty);
     }
+#endif // BOARD_FAN_RPM_MAX
 
     // set dGPU fan duty
+#if BOARD_DGPU_FAN_RPM_MAX
+    // Smoothed duty sets the RPM target, measured every update
+    last_duty_dgpu = fan_smooth(last_duty_dgpu, dgpu_fan_duty);
+    DCR4 = fan_max ? MAX_FAN_SPEED : fan_rpm_control(
+        &FAN_RPM_DGPU,
+        last_duty_dgpu,
+        fan_tach_rpm(F2TLRR, F2TMRR)
+    );
+#else // BOARD_DGPU_FAN_RPM_MAX
     if (dgpu_fan_duty != DCR4) {
         TRACE("DGPU fan_duty_raw=%d\n", dgpu_fan_duty);
         last_duty_dgpu = dgpu_fan_duty = fan_smooth(last_duty_dgpu, dgpu_fan_duty);
         DCR4 = fan_max ? MAX_FAN_SPEED : dgpu_fan_duty;
         TRACE("DGPU fan_duty_smoothed=%d\n", dgpu_fan_duty);
     }
+#endif // BOARD_DGPU_FAN_RPM_MAX
 }
 
-uint8_t fan_heatup(const struct Fan * fan, uint8_t duty) __reentrant {
-    uint8_t lowest = duty;
+// Add duty to a sliding window and return the lowest or highest duty in it.
+// Entries that can no longer be the result are dropped as new duty is added,
+// so each update takes constant time on average regardless of window size.
+static uint8_t fan_window(struct FanWindow * window, uint8_t duty, bool highest) __reentrant {
+    struct FanWindowEntry * entries = window->entries;
 
-    uint8_t i;
-    for (i = 0; (i + 1) < fan->heatup_size; i++) {
-        uint8_t value = fan->heatup[i + 1];
-        if (value < lowest) {
-            lowest = value;
+    // Drop the oldest entry if it has left the window
+    if (window->len && (uint8_t)(window->time - entries[window->head].time) >= window->size) {
+        window->head++;
+        if (window->head >= window->size) {
+            window->head = 0;
         }
-        fan->heatup[i] = value;
+        window->len--;
     }
-    fan->heatup[i] = duty;
-
-    return lowest;
-}
 
-uint8_t fan_cooldown(const struct Fan * fan, uint8_t duty) __reentrant {
-    uint8_t highest = duty;
-
-    uint8_t i;
-    for (i = 0; (i + 1) < fan->cooldown_size; i++) {
-        uint8_t value = fan->cooldown[i + 1];
-        if (value > highest) {
-            highest = value;
+    // Drop newer entries that the new duty supersedes
+    while (window->len) {
+        uint8_t back = window->head + window->len - 1;
+        if (back >= window->size) {
+            back -= window->size;
+        }
+        if (highest ? (entries[back].duty > duty) : (entries[back].duty < duty)) {
+            break;
         }
-        fan->cooldown[i] = value;
+        window->len--;
+    }
+
+    uint8_t next = window->head + window->len;
+    if (next >= window->size) {
+        next -= window->size;
     }
-    fan->cooldown[i] = duty;
+    entries[next].duty = duty;
+    entries[next].time = window->time;
+    window->len++;
+    window->time++;
+
+    return entries[window->head].duty;
+}
 
-    return highest;
+uint8_t fan_heatup(const struct Fan * fan, uint8_t duty) __reentrant {
+    return fan_window(fan->heatup, duty, false);
+}
+
+uint8_t fan_cooldown(const struct Fan * fan, uint8_t duty) __reentrant {
+    return fan_window(fan->cooldown, duty, true);
 }
 
 uint8_t fan_smooth(uint8_t last_duty, uint8_t duty) __reentrant {
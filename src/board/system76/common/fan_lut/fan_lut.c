@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-3.0-only
+//
+// Fan curves, which are not compiled but preprocessed by scripts/fan_lut.sh
+// to generate the per-degree duty tables in fan_lut.h
+
+#include <board/fan.h>
+
+// Temperature in degrees C, duty cycle in percent
+#define FAN_POINT(T, D) T:D
+
+__fan_lut__(PECI, SMOOTH_FANS,
+#ifdef BOARD_FAN_POINTS
+    BOARD_FAN_POINTS
+#else
+    FAN_POINT(70, 40),
+    FAN_POINT(75, 50),
+    FAN_POINT(80, 60),
+    FAN_POINT(85, 65),
+    FAN_POINT(90, 65)
+#endif
+)
+
+__fan_lut__(DGPU, SMOOTH_FANS,
+#ifdef BOARD_DGPU_FAN_POINTS
+    BOARD_DGPU_FAN_POINTS
+#else
+    FAN_POINT(70, 40),
+    FAN_POINT(75, 50),
+    FAN_POINT(80, 60),
+    FAN_POINT(85, 65),
+    FAN_POINT(90, 65)
+#endif
+)
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <board/flash.h>
 #include <flash/entry.h>
@@ -24,6 +25,8 @@ volatile uint8_t __xdata __at(0x103F) ECINDDR;
 #define SPI_READ_COMMAND            (0x0B)
 #define SPI_WRITE_COMMAND           (0x02)
 #define SPI_WRITE_ENABLE_COMMAND    (0x06)
+#define SPI_WRITE_DISABLE_COMMAND   (0x04)
+#define SPI_AAI_WORD_PROGRAM        (0xAD)
 #define SPI_READ_STATUS_COMMAND     (0x05)
 
 #define SPI_ERASE_SECTOR_COMMAND    (0xD7)
@@ -34,6 +37,7 @@ void flash_enter_follow_mode(void);
 void flash_exit_follow_mode(void);
 void flash_wait(void);
 void flash_write_enable(void);
+void flash_write_disable(void);
 
 /**
  * Main flash API entry point.
@@ -54,50 +58,84 @@ void flash_entry(uint32_t addr, uint8_t * data, uint32_t length, uint8_t command
         return;
 
     if (command == FLASH_COMMAND_READ) {
-        while (length) {
-            // Fast read.
-            ECINDAR3 = SPI_DEVICE;
-            ECINDAR2 = addr >> 16;
-            ECINDAR1 = addr >> 8;
-            ECINDAR0 = addr;
+        flash_enter_follow_mode();
+
+        // Select the device
+        ECINDAR1 = SPI_CHIP_SELECT;
+
+        // Send fast read command with address and dummy byte
+        ECINDDR = SPI_READ_COMMAND;
+        ECINDDR = addr >> 16;
+        ECINDDR = addr >> 8;
+        ECINDDR = addr;
+        ECINDDR = 0x00;
 
+        // The chip increments the address, so data can be clocked out
+        while (length) {
             *data = ECINDDR;
 
-            addr++;
             data++;
             length--;
         }
+
+        // Deselect
+        ECINDAR1 = SPI_CHIP_DESELECT;
+        ECINDDR  = 0x00;
+
+        flash_exit_follow_mode();
     } else if (command == FLASH_COMMAND_WRITE) {
+        // Auto address increment word program. Programming 0xFF leaves a byte
+        // unchanged, so it is used to pad an unaligned start or end.
+        bool first = true;
+        bool pad = addr & 1;
+
         flash_enter_follow_mode();
 
-        while (length) {
-            // Note, this is the slow way to do it, but it's simple and all bytes are written properly.
-            flash_write_enable();
+        flash_write_enable();
 
+        while (length) {
             // Select the device
             ECINDAR1 = SPI_CHIP_SELECT;
 
-            // Send write command
-            ECINDDR = SPI_WRITE_COMMAND;
-            ECINDDR = addr >> 16;
-            ECINDDR = addr >> 8;
-            ECINDDR = addr;
-
-            ECINDDR = *data;
-
-            addr++;
-            data++;
-            length--;
+            // Send AAI command, with the word aligned address on the first word
+            ECINDDR = SPI_AAI_WORD_PROGRAM;
+            if (first) {
+                ECINDDR = addr >> 16;
+                ECINDDR = addr >> 8;
+                ECINDDR = addr & 0xFE;
+                first = false;
+            }
+
+            // Send low byte
+            if (pad) {
+                ECINDDR = 0xFF;
+                pad = false;
+            } else {
+                ECINDDR = *data;
+                data++;
+                length--;
+            }
+
+            // Send high byte
+            if (length) {
+                ECINDDR = *data;
+                data++;
+                length--;
+            } else {
+                ECINDDR = 0xFF;
+            }
 
             // Deselect
             ECINDAR1 = SPI_CHIP_DESELECT;
             ECINDDR  = 0x00;
 
-
             // Wait WIP to be cleared
             flash_wait();
         }
 
+        // Leave AAI mode
+        flash_write_disable();
+
         flash_exit_follow_mode();
     } else if (command == FLASH_COMMAND_ERASE_1K) {
         flash_enter_follow_mode();
@@ -171,3 +209,15 @@ void flash_write_enable(void) {
     ECINDAR1 = SPI_CHIP_DESELECT;
     ECINDDR  = 0x00;
 }
+
+void flash_write_disable(void) {
+    // Select the device
+    ECINDAR1 = SPI_CHIP_SELECT;
+
+    // Send write disable command
+    ECINDDR = SPI_WRITE_DISABLE_COMMAND;
+
+    // Deselect
+    ECINDAR1 = SPI_CHIP_DESELECT;
+    ECINDDR  = 0x00;
+}
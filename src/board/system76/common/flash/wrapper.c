@@ -15,18 +15,45 @@ uint8_t __code __at(FLASH_OFFSET) flash_rom[] = {
     #include <flash.h>
 };
 
+// Nesting depth of flash sessions
+static uint8_t flash_session = 0;
+
+void flash_begin(void) {
+    if (flash_session++ == 0) {
+        // Use DMA mapping to copy flash ROM to scratch ROM
+        SCARH = 0x80;
+        SCARL = (uint8_t)(FLASH_OFFSET);
+        SCARM = (uint8_t)(FLASH_OFFSET >> 8);
+        SCARH = 0;
+    }
+}
+
+void flash_end(void) {
+    if (flash_session && --flash_session == 0) {
+        // Disable scratch ROM
+        SCARH = 0x07;
+    }
+}
+
 static void flash_api(uint32_t addr, uint8_t * data, uint32_t length, uint8_t command) {
-    // Use DMA mapping to copy flash ROM to scratch ROM
-    SCARH = 0x80;
-    SCARL = (uint8_t)(FLASH_OFFSET);
-    SCARM = (uint8_t)(FLASH_OFFSET >> 8);
-    SCARH = 0;
+    // Map flash ROM unless a session already has
+    flash_begin();
 
     // Jump to flash ROM
     flash_entry(addr, data, length, command);
 
-    // Disable scratch ROM
-    SCARH = 0x07;
+    flash_end();
+}
+
+void flash_batch(const struct FlashRequest * requests, uint8_t count) {
+    flash_begin();
+
+    for (uint8_t i = 0; i < count; i++) {
+        const struct FlashRequest * request = &requests[i];
+        flash_entry(request->addr, request->data, request->length, request->command);
+    }
+
+    flash_end();
 }
 
 void flash_read(uint32_t addr, __xdata uint8_t * data, uint32_t length) {
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef _BOARD_BOOT_H
+#define _BOARD_BOOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Events used to measure boot and resume time
+enum BootMark {
+    // Power switch press was confirmed, which starts a new measurement
+    BOOT_MARK_POWER_BUTTON = 0,
+    // PLT_RST# was de-asserted, and the CPU starts running firmware
+    BOOT_MARK_PLT_RST,
+    // ACPI OS driver wrote ECOS
+    BOOT_MARK_ACPI_OS,
+    BOOT_MARK_COUNT,
+};
+
+void boot_mark(enum BootMark mark);
+// Get the time in ms of the last mark, if it happened since the power button
+bool boot_mark_get(enum BootMark mark, uint32_t * time);
+
+#endif // _BOARD_BOOT_H
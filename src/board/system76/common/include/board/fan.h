@@ -31,19 +31,63 @@
     #define SMOOTH_FANS_MIN 0 // default to smoothing all fan speed changes
 #endif
 
-struct FanPoint {
-    int16_t temp;
+// Closed loop controller, gains are in 1/256 duty units
+struct FanPid {
+    // Temperature to hold in degrees C
+    int16_t target;
+    // Duty per degree of error
+    int16_t kp;
+    // Duty per degree of error, accumulated every update
+    int16_t ki;
+    // Duty per degree of change since the last update
+    int16_t kd;
+    // Duty per watt of package power
+    int16_t kff;
+    // Accumulated integral term, in 1/256 duty units
+    int32_t integral;
+    int16_t last_temp;
+    bool valid;
+};
+
+struct FanWindowEntry {
+    uint8_t duty;
+    // Update count when added
+    uint8_t time;
+};
+
+// Sliding window minimum or maximum of duty over the last size updates, kept
+// as a ring of the entries that can still become the result, oldest first.
+// The window starts as if full of zero duty, so it is initialized with one
+// zero entry added before the first update (len = 1 and time = 1).
+struct FanWindow {
+    struct FanWindowEntry * entries;
+    uint8_t size;
+    uint8_t head;
+    uint8_t len;
+    uint8_t time;
+};
+
+// Tachometer closed loop state
+struct FanRpm {
+    // RPM at full duty, used to convert duty into an RPM target
+    uint16_t max;
+    // Duty currently driven
     uint8_t duty;
+    // Updates without tachometer pulses while driven
+    uint8_t stall;
+    // Updates remaining at full duty to spin up the fan
+    uint8_t kick;
 };
 
 struct Fan {
-    const struct FanPoint * points;
-    uint8_t points_size;
-    uint8_t * heatup;
-    uint8_t heatup_size;
-    uint8_t * cooldown;
-    uint8_t cooldown_size;
-    bool interpolate;
+    // Duty for each degree, starting at lut_temp
+    const uint8_t * lut;
+    int16_t lut_temp;
+    uint8_t lut_size;
+    struct FanWindow * heatup;
+    struct FanWindow * cooldown;
+    // Closed loop controller, or NULL to use only the fan curve
+    struct FanPid * pid;
 };
 
 extern bool fan_max;
@@ -52,6 +96,10 @@ void fan_reset(void);
 
 uint8_t fan_duty(const struct Fan * fan, int16_t temp) __reentrant;
 void fan_duty_set(uint8_t peci_fan_duty, uint8_t dgpu_fan_duty) __reentrant;
+uint8_t fan_pid(const struct Fan * fan, int16_t temp, int16_t power) __reentrant;
+void fan_pid_reset(const struct Fan * fan) __reentrant;
+uint16_t fan_tach_rpm(uint8_t low, uint8_t high);
+uint8_t fan_rpm_control(struct FanRpm * rpm, uint8_t duty, uint16_t measured) __reentrant;
 uint8_t fan_heatup(const struct Fan * fan, uint8_t duty) __reentrant;
 uint8_t fan_cooldown(const struct Fan * fan, uint8_t duty) __reentrant;
 uint8_t fan_smooth(uint8_t last_duty, uint8_t duty) __reentrant;
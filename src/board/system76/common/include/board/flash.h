@@ -17,6 +17,42 @@
 #define FLASH_COMMAND_ERASE_1K  (0x2)
 /** \endcond */
 
+/**
+ * A single flash operation, for use with flash_batch.
+ */
+struct FlashRequest {
+    /** The flash address to access. */
+    uint32_t addr;
+    /** The memory area to copy to or from, unused for erase. */
+    uint8_t * data;
+    /** The number of bytes to copy, unused for erase. */
+    uint32_t length;
+    /** One of the FLASH_COMMAND values. */
+    uint8_t command;
+};
+
+/**
+ * Map the flash ROM until the matching flash_end.
+ *
+ * Every flash function maps the flash ROM into scratch ROM and unmaps it
+ * again. Wrapping several calls in a session pays for the mapping once.
+ * Sessions may be nested.
+ */
+void flash_begin(void);
+
+/**
+ * End a session started with flash_begin.
+ */
+void flash_end(void);
+
+/**
+ * Run a list of flash operations with a single mapping of the flash ROM.
+ *
+ * \param[in] requests The operations to run, in order.
+ * \param[in] count    The number of operations.
+ */
+void flash_batch(const struct FlashRequest * requests, uint8_t count);
+
 /**
  * Read data from flash to the specified buffer.
  *
@@ -7,8 +7,10 @@
 
 extern bool peci_on;
 extern int16_t peci_temp;
+extern int16_t peci_power;
 
 void peci_init(void);
+int16_t peci_rd_pkg_config(uint8_t index, uint16_t param, uint32_t * data);
 int16_t peci_wr_pkg_config(uint8_t index, uint16_t param, uint32_t data);
 uint8_t peci_get_fan_duty(void);
 
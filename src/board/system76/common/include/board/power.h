@@ -3,6 +3,9 @@
 #ifndef _BOARD_POWER_H
 #define _BOARD_POWER_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 enum PowerState {
     POWER_STATE_OFF,
     POWER_STATE_S5,
@@ -12,6 +15,41 @@ enum PowerState {
 
 extern enum PowerState power_state;
 
+// Signals recorded in the power sequencing trace
+enum PowerTraceId {
+    // Value is the new enum PowerState
+    POWER_TRACE_STATE = 0,
+    POWER_TRACE_PWR_SW_N,
+    POWER_TRACE_VA_EC_EN,
+    POWER_TRACE_PD_EN,
+    POWER_TRACE_DD_ON,
+    POWER_TRACE_SUS_PWR_ACK,
+    POWER_TRACE_PCH_DPWROK_EC,
+    POWER_TRACE_EC_RSMRST_N,
+    POWER_TRACE_EC_EN,
+    POWER_TRACE_PWR_BTN_N,
+    POWER_TRACE_PM_PWROK,
+    POWER_TRACE_PCH_PWROK_EC,
+    POWER_TRACE_ALL_SYS_PWRGD,
+    POWER_TRACE_BUF_PLT_RST_N,
+    POWER_TRACE_SLP_SUS_N,
+    POWER_TRACE_SUSWARN_N,
+    POWER_TRACE_LAN_WAKEUP_N,
+};
+
+struct PowerTrace {
+    // Time in us from time_get_us
+    uint32_t time;
+    uint8_t id;
+    uint8_t value;
+};
+
+// Number of recorded entries, up to POWER_TRACE_SIZE
+uint8_t power_trace_count(void);
+// Read an entry, with index 0 being the oldest
+bool power_trace_get(uint8_t index, struct PowerTrace * trace);
+void power_trace_clear(void);
+
 void power_init(void);
 void power_on(void);
 void power_off(void);
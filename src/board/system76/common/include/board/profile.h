@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef _BOARD_PROFILE_H
+#define _BOARD_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <arch/time.h>
+
+// Main loop tasks, in the order they are reported to the host
+enum ProfileTask {
+    PROFILE_POWER = 0,
+    PROFILE_KBSCAN,
+    PROFILE_LID,
+    PROFILE_FAN,
+    PROFILE_BATTERY,
+    PROFILE_BOARD,
+    PROFILE_KBC,
+    PROFILE_PMC,
+    PROFILE_SMFI,
+    PROFILE_STDIO,
+    PROFILE_COUNT,
+};
+
+// Durations are in timer 0 ticks, see TIME_TICKS_PER_MS
+struct ProfileStats {
+    uint32_t min;
+    uint32_t max;
+    uint32_t total;
+    uint32_t count;
+};
+
+#if PROFILE
+void profile_record(enum ProfileTask task, uint32_t start);
+bool profile_get(uint8_t index, struct ProfileStats * stats);
+void profile_reset(void);
+
+// Run a statement and record how long it took
+#define PROFILE_RUN(task, statement) { \
+    uint32_t profile_start = time_get_ticks(); \
+    statement; \
+    profile_record(task, profile_start); \
+}
+#else // PROFILE
+#define PROFILE_RUN(task, statement) { statement; }
+#endif // PROFILE
+
+#endif // _BOARD_PROFILE_H
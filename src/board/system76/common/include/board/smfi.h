@@ -9,5 +9,6 @@ void smfi_init(void);
 void smfi_watchdog(void);
 void smfi_event(void);
 void smfi_debug(uint8_t byte);
+void smfi_telemetry(void);
 
 #endif // _BOARD_SMFI_H
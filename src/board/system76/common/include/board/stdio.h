@@ -0,0 +1,8 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef _BOARD_STDIO_H
+#define _BOARD_STDIO_H
+
+void stdio_event(void);
+
+#endif // _BOARD_STDIO_H
@@ -313,15 +313,15 @@ void kbscan_event(void) {
     static bool kbscan_ghost[KM_OUT] = { false };
 
     static bool debounce = false;
-    static uint32_t debounce_time = 0;
+    static uint16_t debounce_time = 0;
 
     static bool repeat = false;
     static uint16_t repeat_key = 0;
-    static uint32_t repeat_key_time = 0;
+    static uint16_t repeat_key_time = 0;
 
     // If debounce complete
     if (debounce) {
-        uint32_t time = time_get();
+        uint16_t time = time_get_fast();
         if ((time - debounce_time) >= DEBOUNCE_DELAY) {
             // Finish debounce
             debounce = false;
@@ -339,7 +339,7 @@ void kbscan_event(void) {
                 kbscan_ghost[i] = false;
                 // Debounce to allow remaining ghosts to settle.
                 debounce = true;
-                debounce_time = time_get();
+                debounce_time = time_get_fast();
             }
 
             // A key was pressed or released
@@ -356,7 +356,7 @@ void kbscan_event(void) {
                     } else {
                         // Begin debounce
                         debounce = true;
-                        debounce_time = time_get();
+                        debounce_time = time_get_fast();
 
                         // Check keys used for config reset
                         if (matrix_position_is_esc(i, j))
@@ -382,7 +382,7 @@ void kbscan_event(void) {
                             if (new_b) {
                                 // New key pressed, update last key
                                 repeat_key = key;
-                                repeat_key_time = time_get();
+                                repeat_key_time = time_get_fast();
                                 repeat = false;
                             } else if (key == repeat_key) {
                                 // Repeat key was released
@@ -408,14 +408,12 @@ void kbscan_event(void) {
             kbscan_matrix[i] = new;
         } else if (new && repeat_key != 0 && key_should_repeat(repeat_key)) {
             // A key is being pressed
-            uint32_t time = time_get();
-            static uint32_t repeat_start = 0;
+            uint16_t time = time_get_fast();
+            static uint16_t repeat_start = 0;
 
             if (!repeat) {
-                if (time < repeat_key_time) {
-                    // Overflow, reset repeat_key_time
-                    repeat_key_time = time;
-                } else if ((time - repeat_key_time) >= kbscan_repeat_delay) {
+                // Unsigned subtraction handles the time wrapping
+                if ((time - repeat_key_time) >= kbscan_repeat_delay) {
                     // Typematic repeat
                     repeat = true;
                     repeat_start = time;
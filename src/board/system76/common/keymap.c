@@ -2,6 +2,7 @@
 
 #include <board/flash.h>
 #include <board/keymap.h>
+#include <common/macro.h>
 
 uint16_t __xdata DYNAMIC_KEYMAP[KM_LAY][KM_OUT][KM_IN];
 
@@ -35,26 +36,52 @@ bool keymap_erase_config(void) {
 }
 
 bool keymap_load_config(void) {
+    bool ret = false;
+
+    flash_begin();
+
     // Check signature
-    if (flash_read_u16(CONFIG_ADDR) != CONFIG_SIGNATURE) return false;
+    if (flash_read_u16(CONFIG_ADDR) == CONFIG_SIGNATURE) {
+        // Read the keymap if signature is valid
+        flash_read(CONFIG_ADDR + sizeof(CONFIG_SIGNATURE), (uint8_t *)DYNAMIC_KEYMAP, sizeof(DYNAMIC_KEYMAP));
+        ret = true;
+    }
 
-    // Read the keymap if signature is valid
-    flash_read(CONFIG_ADDR + sizeof(CONFIG_SIGNATURE), (uint8_t *)DYNAMIC_KEYMAP, sizeof(DYNAMIC_KEYMAP));
-    return true;
+    flash_end();
+
+    return ret;
 }
 
 bool keymap_save_config(void) {
-    // Erase config region
-    if (!keymap_erase_config()) return false;
+    struct FlashRequest requests[2];
+    uint16_t signature = CONFIG_SIGNATURE;
+    bool ret = false;
 
     // Write the keymap
-    flash_write(CONFIG_ADDR + sizeof(CONFIG_SIGNATURE), (uint8_t *)DYNAMIC_KEYMAP, sizeof(DYNAMIC_KEYMAP));
+    requests[0].addr = CONFIG_ADDR + sizeof(CONFIG_SIGNATURE);
+    requests[0].data = (uint8_t *)DYNAMIC_KEYMAP;
+    requests[0].length = sizeof(DYNAMIC_KEYMAP);
+    requests[0].command = FLASH_COMMAND_WRITE;
 
     // Write the length of the keymap, as a signature
-    flash_write_u16(CONFIG_ADDR, CONFIG_SIGNATURE);
+    requests[1].addr = CONFIG_ADDR;
+    requests[1].data = (uint8_t *)&signature;
+    requests[1].length = sizeof(signature);
+    requests[1].command = FLASH_COMMAND_WRITE;
+
+    flash_begin();
+
+    // Erase config region
+    if (keymap_erase_config()) {
+        flash_batch(requests, ARRAY_SIZE(requests));
+
+        // Verify signature is valid
+        ret = flash_read_u16(CONFIG_ADDR) == CONFIG_SIGNATURE;
+    }
+
+    flash_end();
 
-    // Verify signature is valid
-    return flash_read_u16(CONFIG_ADDR) == CONFIG_SIGNATURE;
+    return ret;
 }
 
 bool keymap_get(uint8_t layer, uint8_t output, uint8_t input, uint16_t * value) {
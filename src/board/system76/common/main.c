@@ -5,7 +5,7 @@
 
 #include <arch/arch.h>
 #include <arch/delay.h>
-#include <arch/time.h>
+#include <arch/timer.h>
 #include <board/battery.h>
 #include <board/board.h>
 #include <board/dgpu.h>
@@ -21,10 +21,12 @@
 #include <board/peci.h>
 #include <board/pmc.h>
 #include <board/power.h>
+#include <board/profile.h>
 #include <board/ps2.h>
 #include <board/pwm.h>
 #include <board/smbus.h>
 #include <board/smfi.h>
+#include <board/stdio.h>
 #include <common/debug.h>
 #include <common/macro.h>
 #include <common/version.h>
@@ -45,9 +47,24 @@ void timer_2(void) __interrupt(5) {}
 uint8_t main_cycle = 0;
 const uint16_t battery_interval = 1000;
 // update fan speed more frequently for smoother fans
-// NOTE: event loop is longer than 100ms and maybe even longer than 250
 const uint16_t fan_interval = SMOOTH_FANS != 0 ? 250 : 1000;
 
+static void fan_timer(void) {
+    // Update fan speeds
+    PROFILE_RUN(PROFILE_FAN, fan_duty_set(peci_get_fan_duty(), dgpu_get_fan_duty()));
+
+    // Update telemetry with new temperatures and duties
+    smfi_telemetry();
+}
+
+static void battery_timer(void) {
+    // Updates battery status
+    PROFILE_RUN(PROFILE_BATTERY, battery_event());
+
+    // Update telemetry with new battery status
+    smfi_telemetry();
+}
+
 void init(void) {
     // Must happen first
     arch_init();
@@ -96,14 +113,14 @@ void main(void) {
 
     INFO("System76 EC board '%s', version '%s'\n", board(), version());
 
-    uint32_t last_time_battery = 0;
-    uint32_t last_time_fan = 0;
+    timer_add(fan_timer, fan_interval, true);
+    timer_add(battery_timer, battery_interval, true);
 
     for(main_cycle = 0; ; main_cycle++) {
         switch (main_cycle % 3U) {
             case 0:
                 // Handle power states
-                power_event();
+                PROFILE_RUN(PROFILE_POWER, power_event());
                 break;
             case 1:
 #if PARALLEL_DEBUG
@@ -111,43 +128,29 @@ void main(void) {
 #endif // PARALLEL_DEBUG
                 {
                     // Scans keyboard and sends keyboard packets
-                    kbscan_event();
+                    PROFILE_RUN(PROFILE_KBSCAN, kbscan_event());
                 }
                 break;
             case 2:
                 // Handle lid close/open
-                lid_event();
+                PROFILE_RUN(PROFILE_LID, lid_event());
                 break;
         }
 
-        if (main_cycle == 0) {
-            uint32_t time = time_get();
-            // Only run the following once per interval
-            if ((time - last_time_fan) >= fan_interval) {
-                last_time_fan = time;
-
-                // Update fan speeds
-                fan_duty_set(peci_get_fan_duty(), dgpu_get_fan_duty());
-            }
-
-            // Only run the following once per interval
-            if ((time - last_time_battery) >= battery_interval) {
-                last_time_battery = time;
-
-                // Updates battery status
-                battery_event();
-            }
-        }
+        // Runs periodic and scheduled work
+        timer_event();
 
         // Board-specific events
-        board_event();
+        PROFILE_RUN(PROFILE_BOARD, board_event());
 
         // Checks for keyboard/mouse packets from host
-        kbc_event(&KBC);
+        PROFILE_RUN(PROFILE_KBC, kbc_event(&KBC));
         // Handles ACPI communication
-        pmc_event(&PMC_1);
+        PROFILE_RUN(PROFILE_PMC, pmc_event(&PMC_1));
         // AP/EC communication over SMFI
-        smfi_event();
+        PROFILE_RUN(PROFILE_SMFI, smfi_event());
+        // Sends buffered debug output to external debuggers
+        PROFILE_RUN(PROFILE_STDIO, stdio_event());
         // Idle until next timer interrupt
         //Disabled until interrupts used: PCON |= 1;
     }
@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <arch/time.h>
 #include <board/fan.h>
 #include <board/gpio.h>
 #include <board/peci.h>
@@ -9,6 +10,7 @@
 #include <ec/espi.h>
 #include <ec/gpio.h>
 #include <ec/pwm.h>
+#include <fan_lut.h>
 
 #ifndef USE_S0IX
     #define USE_S0IX 0
@@ -19,46 +21,85 @@
     #define BOARD_HEATUP 4
 #endif
 
-static uint8_t FAN_HEATUP[BOARD_HEATUP] = { 0 };
+static struct FanWindowEntry FAN_HEATUP_ENTRIES[BOARD_HEATUP] = { 0 };
+static struct FanWindow FAN_HEATUP = {
+    .entries = FAN_HEATUP_ENTRIES,
+    .size = ARRAY_SIZE(FAN_HEATUP_ENTRIES),
+    .head = 0,
+    .len = 1,
+    .time = 1,
+};
 
 // Fan speed is the highest HEATUP speed over COOLDOWN seconds
 #ifndef BOARD_COOLDOWN
     #define BOARD_COOLDOWN 10
 #endif
 
-static uint8_t FAN_COOLDOWN[BOARD_COOLDOWN] = { 0 };
+static struct FanWindowEntry FAN_COOLDOWN_ENTRIES[BOARD_COOLDOWN] = { 0 };
+static struct FanWindow FAN_COOLDOWN = {
+    .entries = FAN_COOLDOWN_ENTRIES,
+    .size = ARRAY_SIZE(FAN_COOLDOWN_ENTRIES),
+    .head = 0,
+    .len = 1,
+    .time = 1,
+};
 
 // Tjunction = 100C for i7-8565U (and probably the same for all WHL-U)
 #define T_JUNCTION 100
 
+// Use the closed loop controller instead of the fan curve
+#ifndef BOARD_FAN_PID
+    #define BOARD_FAN_PID 0
+#endif
+
+#if BOARD_FAN_PID
+    #ifndef BOARD_FAN_PID_TARGET
+        #define BOARD_FAN_PID_TARGET (T_JUNCTION - 15)
+    #endif
+    #ifndef BOARD_FAN_PID_KP
+        #define BOARD_FAN_PID_KP 2048 // 8 duty per degree
+    #endif
+    #ifndef BOARD_FAN_PID_KI
+        #define BOARD_FAN_PID_KI 64 // 0.25 duty per degree per update
+    #endif
+    #ifndef BOARD_FAN_PID_KD
+        #define BOARD_FAN_PID_KD 0
+    #endif
+    #ifndef BOARD_FAN_PID_KFF
+        #define BOARD_FAN_PID_KFF 512 // 2 duty per watt
+    #endif
+
+static struct FanPid FAN_PID = {
+    .target = BOARD_FAN_PID_TARGET,
+    .kp = BOARD_FAN_PID_KP,
+    .ki = BOARD_FAN_PID_KI,
+    .kd = BOARD_FAN_PID_KD,
+    .kff = BOARD_FAN_PID_KFF,
+    .integral = 0,
+    .last_temp = 0,
+    .valid = false,
+};
+#endif // BOARD_FAN_PID
+
 bool peci_on = false;
 int16_t peci_temp = 0;
+// Package power in watts, only measured when used by the fan controller
+int16_t peci_power = 0;
 
 #define PECI_TEMP(X) ((int16_t)(X))
 
-#define FAN_POINT(T, D) { .temp = PECI_TEMP(T), .duty = PWM_DUTY(D) }
-
-// Fan curve with temperature in degrees C, duty cycle in percent
-static struct FanPoint __code FAN_POINTS[] = {
-#ifdef BOARD_FAN_POINTS
-    BOARD_FAN_POINTS
-#else
-    FAN_POINT(70, 40),
-    FAN_POINT(75, 50),
-    FAN_POINT(80, 60),
-    FAN_POINT(85, 65),
-    FAN_POINT(90, 65)
-#endif
-};
+// Fan curve with duty for each degree C, generated from BOARD_FAN_POINTS
+static uint8_t __code FAN_LUT[] = PECI_FAN_LUT;
 
 static struct Fan __code FAN = {
-    .points = FAN_POINTS,
-    .points_size = ARRAY_SIZE(FAN_POINTS),
-    .heatup = FAN_HEATUP,
-    .heatup_size = ARRAY_SIZE(FAN_HEATUP),
-    .cooldown = FAN_COOLDOWN,
-    .cooldown_size = ARRAY_SIZE(FAN_COOLDOWN),
-    .interpolate = SMOOTH_FANS != 0,
+    .lut = FAN_LUT,
+    .lut_temp = PECI_TEMP(PECI_FAN_LUT_TEMP),
+    .lut_size = ARRAY_SIZE(FAN_LUT),
+    .heatup = &FAN_HEATUP,
+    .cooldown = &FAN_COOLDOWN,
+#if BOARD_FAN_PID
+    .pid = &FAN_PID,
+#endif
 };
 
 void peci_init(void) {
@@ -122,6 +163,106 @@ int16_t peci_wr_pkg_config(uint8_t index, uint16_t param, uint32_t data) {
     }
 }
 
+// Returns positive completion code on success, negative completion code or
+// negative (0x1000 | status register) on PECI hardware error
+int16_t peci_rd_pkg_config(uint8_t index, uint16_t param, uint32_t * data) {
+    // Wait for completion
+    while (HOSTAR & 1) {}
+    // Clear status
+    HOSTAR = HOSTAR;
+
+    // Enable PECI, clearing data fifo's
+    HOCTLR = BIT(5) | BIT(3);
+    // Set address to default
+    HOTRADDR = 0x30;
+    // Set write length
+    HOWRLR = 5;
+    // Set read length
+    HORDLR = 5;
+    // Set command
+    HOCMDR = 0xA1;
+
+    // Write host ID
+    HOWRDR = 0;
+    // Write index
+    HOWRDR = index;
+    // Write param
+    HOWRDR = (uint8_t)param;
+    HOWRDR = (uint8_t)(param >> 8);
+
+    // Start transaction
+    HOCTLR |= 1;
+
+    // Wait for completion
+    while (HOSTAR & 1) {}
+
+    int16_t status = (int16_t)HOSTAR;
+    if (status & BIT(1)) {
+        int16_t cc = (int16_t)HORDDR;
+        // Read data
+        *data = (uint32_t)HORDDR;
+        *data |= ((uint32_t)HORDDR) << 8;
+        *data |= ((uint32_t)HORDDR) << 16;
+        *data |= ((uint32_t)HORDDR) << 24;
+        if (cc & 0x80) {
+            return -cc;
+        } else {
+            return cc;
+        }
+    } else {
+        return -(0x1000 | status);
+    }
+}
+
+#if BOARD_FAN_PID
+// Energy units are 1/2^unit joules, 0 if not yet read
+static uint8_t peci_energy_unit = 0;
+static uint32_t peci_energy = 0;
+static uint32_t peci_energy_time = 0;
+
+static void peci_power_reset(void) {
+    peci_power = 0;
+    peci_energy_unit = 0;
+}
+
+// Update package power from the change in the package energy counter
+static void peci_power_update(void) {
+    uint32_t data;
+
+    if (peci_energy_unit == 0) {
+        // Package power SKU unit
+        if (peci_rd_pkg_config(30, 0, &data) != 0x40) {
+            return;
+        }
+        peci_energy_unit = (uint8_t)((data >> 8) & 0x1F);
+        if (peci_energy_unit == 0) {
+            return;
+        }
+        // Read the counter again below to start the first interval
+        peci_energy_time = 0;
+    }
+
+    // Package energy status
+    if (peci_rd_pkg_config(3, 0xFF, &data) != 0x40) {
+        peci_power_reset();
+        return;
+    }
+
+    uint32_t time = time_get();
+    if (peci_energy_time != 0) {
+        uint32_t elapsed = time - peci_energy_time;
+        if (elapsed == 0) {
+            return;
+        }
+        // Divide first so the counter delta cannot overflow
+        uint32_t delta = (data - peci_energy) / elapsed;
+        peci_power = (int16_t)((delta * 1000) >> peci_energy_unit);
+    }
+    peci_energy = data;
+    peci_energy_time = time;
+}
+#endif // BOARD_FAN_PID
+
 // PECI information can be found here: https://www.intel.com/content/dam/www/public/us/en/documents/design-guides/core-i7-lga-2011-guide.pdf
 uint8_t peci_get_fan_duty(void) {
     uint8_t duty;
@@ -163,27 +304,38 @@ uint8_t peci_get_fan_duty(void) {
             uint16_t peci_offset = (((int16_t)high << 8) | (int16_t)low) >> 6;
 
             peci_temp = PECI_TEMP(T_JUNCTION) + peci_offset;
+#if BOARD_FAN_PID
+            peci_power_update();
+            duty = fan_pid(&FAN, peci_temp, peci_power);
+#else // BOARD_FAN_PID
             duty = fan_duty(&FAN, peci_temp);
+#endif // BOARD_FAN_PID
         } else {
             // Default to 50% if there is an error
             peci_temp = 0;
             duty = PWM_DUTY(50);
+            fan_pid_reset(&FAN);
         }
     } else {
         // Turn fan off if not in S0 state
         peci_temp = 0;
         duty = PWM_DUTY(0);
+        fan_pid_reset(&FAN);
+#if BOARD_FAN_PID
+        peci_power_reset();
+#endif // BOARD_FAN_PID
     }
 
     if (peci_on && fan_max) {
         // Override duty if fans are manually set to maximum
         duty = PWM_DUTY(100);
-    } else {
-        // Apply heatup and cooldown filters to duty
+    } else if (!BOARD_FAN_PID) {
+        // Apply heatup and cooldown filters to the fan curve duty, the
+        // controller already has its own integral term
         duty = fan_heatup(&FAN, duty);
         duty = fan_cooldown(&FAN, duty);
     }
 
-    TRACE("PECI temp=%d\n", peci_temp);
+    TRACE("PECI temp=%d power=%d\n", peci_temp, peci_power);
     return duty;
 }
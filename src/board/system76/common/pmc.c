@@ -1,7 +1,7 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
-#include <arch/time.h>
 #include <arch/delay.h>
+#include <arch/timer.h>
 #include <board/acpi.h>
 #include <board/gpio.h>
 #include <board/pmc.h>
@@ -189,24 +189,25 @@ static void pmc_on_output_empty(struct Pmc * pmc) {
 
 #if PMC_S0IX_HACK
 // HACK: Kick PMC to fix suspend on lemp11
+static uint8_t pmc_hack_timer = TIMER_NONE;
+
+// If SLP_S0# not asserted 5 seconds after S0ix was requested, apply the hack
+static void pmc_hack_timeout(void) {
+    if (gpio_get(&SLP_S0_N)) {
+        DEBUG("FIXME: PMC HACK\n");
+        pmc_sci(&PMC_1, 0x50);
+    }
+}
+
 static void pmc_hack(void) {
-    static bool pmc_s0_hack2 = false;
-    static uint32_t last_time = 0;
-    // Get time the system requested S0ix (ACPI MS0X)
+    // Start timeout when the system requests S0ix (ACPI MS0X)
     if (pmc_s0_hack) {
-        last_time = time_get();
         pmc_s0_hack = false;
-        pmc_s0_hack2 = true;
-    }
-    uint32_t time = time_get();
-    // If SLP_S0# not asserted after 5 seconds, apply the hack
-    if ((time - last_time) >= 5000) {
-        if (pmc_s0_hack2 && gpio_get(&SLP_S0_N)) {
-            DEBUG("FIXME: PMC HACK\n");
-            pmc_sci(&PMC_1, 0x50);
+        if (pmc_hack_timer == TIMER_NONE) {
+            pmc_hack_timer = timer_add(pmc_hack_timeout, 5000, false);
+        } else {
+            timer_restart(pmc_hack_timer);
         }
-        pmc_s0_hack2 = false;
-        last_time = time;
     }
 }
 #else
@@ -1,10 +1,13 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <arch/async.h>
 #include <arch/delay.h>
 #include <arch/time.h>
+#include <arch/timer.h>
 #include <board/acpi.h>
 #include <board/battery.h>
 #include <board/board.h>
+#include <board/boot.h>
 #include <board/config.h>
 #include <board/fan.h>
 #include <board/gpio.h>
@@ -28,6 +31,47 @@
 #define GPIO_SET_DEBUG(G, V) { \
     DEBUG("%s = %s\n", #G, V ? "true" : "false"); \
     gpio_set(&G, V); \
+    power_trace(POWER_TRACE_ ## G, V); \
+}
+
+// Number of power trace entries, must be a power of two
+#ifndef POWER_TRACE_SIZE
+    #define POWER_TRACE_SIZE 32
+#endif
+
+static struct PowerTrace power_traces[POWER_TRACE_SIZE];
+static uint8_t power_trace_head = 0;
+static uint8_t power_trace_len = 0;
+
+static void power_trace(uint8_t id, uint8_t value) {
+    struct PowerTrace * trace = &power_traces[power_trace_head];
+    trace->time = time_get_us();
+    trace->id = id;
+    trace->value = value;
+
+    // Overwrite the oldest entry when full
+    power_trace_head = (power_trace_head + 1) & (POWER_TRACE_SIZE - 1);
+    if (power_trace_len < POWER_TRACE_SIZE) {
+        power_trace_len++;
+    }
+}
+
+uint8_t power_trace_count(void) {
+    return power_trace_len;
+}
+
+bool power_trace_get(uint8_t index, struct PowerTrace * trace) {
+    if (index >= power_trace_len) {
+        return false;
+    }
+    uint8_t i = (power_trace_head - power_trace_len + index) & (POWER_TRACE_SIZE - 1);
+    *trace = power_traces[i];
+    return true;
+}
+
+void power_trace_clear(void) {
+    power_trace_head = 0;
+    power_trace_len = 0;
 }
 
 #ifndef HAVE_EC_EN
@@ -92,8 +136,8 @@ extern uint8_t main_cycle;
 #define tPCH01 delay_ms(9)
 // VccDSW stable (95%) to RSMRST# high
 #define tPCH02 delay_ms(10)
-// VccPrimary stable (95%) to RSMRST# high
-#define tPCH03 delay_ms(10)
+// VccPrimary stable (95%) to RSMRST# high, in ms for async_delay
+#define tPCH03_MS 10
 // VccRTC stable (90%) to start of VccDSW voltage ramp
 #define tPCH04 delay_ms(9)
 // RTCRST# high to DSW_PWROK
@@ -114,12 +158,12 @@ extern uint8_t main_cycle;
 #define tPCH12 delay_ns(400)
 // DSW_PWROK falling to any of VccDSW, VccPRIM dropping 5%
 #define tPCH14 delay_ns(400)
-// De-assertion of RSMRST# to de-assertion of ESPI_RESET#
-#define tPCH18 delay_ms(95)
+// De-assertion of RSMRST# to de-assertion of ESPI_RESET#, in ms for async_delay
+#define tPCH18_MS 95
 // DSW_PWROK assertion to SLP_SUS# de-assertion
 #define tPCH32 delay_ms(95)
-// RSMRST# de-assertion to SUSPWRDNACK valid
-#define tPLT01 delay_ms(200)
+// RSMRST# de-assertion to SUSPWRDNACK valid, in ms for async_delay
+#define tPLT01_MS 200
 
 enum PowerState power_state = POWER_STATE_OFF;
 
@@ -148,6 +192,7 @@ void update_power_state(void) {
     enum PowerState new_power_state = calculate_power_state();
     if (power_state != new_power_state) {
         power_state = new_power_state;
+        power_trace(POWER_TRACE_STATE, (uint8_t)power_state);
 
     #if LEVEL >= LEVEL_DEBUG
         switch (power_state) {
@@ -168,6 +213,39 @@ void update_power_state(void) {
     }
 }
 
+// Steps of power_on that run after a delay, from power_event
+enum PowerStep {
+    POWER_STEP_NONE = 0,
+    POWER_STEP_RSMRST,
+    POWER_STEP_EC_EN,
+    POWER_STEP_PWR_BTN,
+    POWER_STEP_PWR_BTN_RELEASE,
+    POWER_STEP_S0,
+};
+
+static struct Async power_async = { 0 };
+
+// Time when waiting for S0 started, from time_get_fast
+static uint16_t power_s0_start = 0;
+
+// Returns true while power_on is still sequencing
+static bool power_sequencing(void) {
+    return power_async.step != POWER_STEP_NONE;
+}
+
+// Steps that wait for ALL_SYS_PWRGD to settle
+enum PgStep {
+    PG_STEP_NONE = 0,
+    PG_STEP_SYS_PWROK,
+};
+
+// Phase of flashing LEDs, toggled every second
+static bool power_blink = false;
+
+static void power_blink_timer(void) {
+    power_blink = !power_blink;
+}
+
 void power_init(void) {
     // See Figure 12-19 in Whiskey Lake Platform Design Guide
     // | VCCRTC | RTCRST# | VccPRIM |
@@ -178,6 +256,8 @@ void power_init(void) {
     tPCH04;
 
     update_power_state();
+
+    timer_add(power_blink_timer, 1000, true);
 }
 
 void power_on(void) {
@@ -205,58 +285,75 @@ void power_on(void) {
     // De-assert SUS_ACK# - TODO is this needed on non-dsx?
     GPIO_SET_DEBUG(SUS_PWR_ACK, true);
 #endif // HAVE_SUS_PWR_ACK
-    tPCH03;
 
+    // The rest of the sequence is run by power_event
+    async_delay(&power_async, POWER_STEP_RSMRST, tPCH03_MS);
+}
+
+static void power_on_step(uint8_t step) {
+    uint16_t elapsed;
+
+    switch (step) {
+        case POWER_STEP_RSMRST:
 #if HAVE_PCH_DPWROK_EC
-    // Assert DSW_PWROK
-    GPIO_SET_DEBUG(PCH_DPWROK_EC, true);
+            // Assert DSW_PWROK
+            GPIO_SET_DEBUG(PCH_DPWROK_EC, true);
 #endif // HAVE_PCH_DPWROK_EC
 
-    // De-assert RSMRST#
-    GPIO_SET_DEBUG(EC_RSMRST_N, true);
-
-    // Wait for PCH stability
-    tPCH18;
+            // De-assert RSMRST#
+            GPIO_SET_DEBUG(EC_RSMRST_N, true);
 
+            // Wait for PCH stability
+            async_delay(&power_async, POWER_STEP_EC_EN, tPCH18_MS);
+            break;
+        case POWER_STEP_EC_EN:
 #if HAVE_EC_EN
-    // Allow processor to control SUSB# and SUSC#
-    GPIO_SET_DEBUG(EC_EN, true);
+            // Allow processor to control SUSB# and SUSC#
+            GPIO_SET_DEBUG(EC_EN, true);
 #endif // HAVE_EC_EN
 
-    // Wait for SUSPWRDNACK validity
-    tPLT01;
-
-    GPIO_SET_DEBUG(PWR_BTN_N, false);
-    delay_ms(32); // PWRBTN# must assert for at least 16 ms, we do twice that
-    GPIO_SET_DEBUG(PWR_BTN_N, true);
-
-    uint16_t i;
-    for (i = 0; i < 5000; i++) {
-        // If we reached S0, exit this loop
-        update_power_state();
-        if (power_state == POWER_STATE_S0) {
-            DEBUG("reached S0 in %d ms\n", i);
+            // Wait for SUSPWRDNACK validity
+            async_delay(&power_async, POWER_STEP_PWR_BTN, tPLT01_MS);
             break;
-        }
-
-        // Check for VW changes
-        #if EC_ESPI
-            espi_event();
-        #endif // EC_ESPI
+        case POWER_STEP_PWR_BTN:
+            GPIO_SET_DEBUG(PWR_BTN_N, false);
+            // PWRBTN# must assert for at least 16 ms, we do twice that
+            async_delay(&power_async, POWER_STEP_PWR_BTN_RELEASE, 32);
+            break;
+        case POWER_STEP_PWR_BTN_RELEASE:
+            GPIO_SET_DEBUG(PWR_BTN_N, true);
+            power_s0_start = time_get_fast();
+            async_delay(&power_async, POWER_STEP_S0, 0);
+            break;
+        case POWER_STEP_S0:
+            // Elapsed ms, unsigned subtraction handles wrap
+            elapsed = time_get_fast() - power_s0_start;
 
-        // Extra wait until SUSPWRDNACK is valid
-        delay_ms(1);
-    }
+            // If we reached S0, the sequence is done
+            update_power_state();
+            if (power_state == POWER_STATE_S0) {
+                DEBUG("reached S0 in %d ms\n", elapsed);
+                break;
+            }
 
-    if (power_state != POWER_STATE_S0) {
-        DEBUG("failed to reach S0, powering off\n");
-        power_off();
+            // Extra wait until SUSPWRDNACK is valid, VW changes are handled
+            // by board_event in the meantime
+            if (elapsed < 5000) {
+                async_delay(&power_async, POWER_STEP_S0, 0);
+            } else {
+                DEBUG("failed to reach S0, powering off\n");
+                power_off();
+            }
+            break;
     }
 }
 
 void power_off(void) {
     DEBUG("%02X: power_off\n", main_cycle);
 
+    // Stop power_on if it is still sequencing
+    async_cancel(&power_async);
+
 #if HAVE_PCH_PWROK_EC
     // De-assert SYS_PWROK
     GPIO_SET_DEBUG(PCH_PWROK_EC, false);
@@ -348,12 +445,18 @@ void power_cpu_reset(void) {
     kbled_reset();
 }
 
+// Time in ms that the power switch must be held before a press is handled
+#define POWER_SWITCH_DEBOUNCE 100
+
 static bool power_button_disabled(void) {
     // Disable power button if lid is closed and AC is disconnected
     return !gpio_get(&LID_SW_N) && gpio_get(&ACIN_N);
 }
 
 void power_event(void) {
+    // Continue power_on sequencing
+    power_on_step(async_poll(&power_async));
+
     // Check if the adapter line goes low
     static bool ac_send_sci = true;
     static bool ac_last = true;
@@ -371,8 +474,8 @@ void power_event(void) {
         }
         battery_debug();
 
-        // Reset main loop cycle to force reading PECI and battery
-        main_cycle = 0;
+        // Read battery now, so the SCI reports the new status
+        battery_event();
 
         // Send SCI to update AC and battery information
         ac_send_sci = true;
@@ -396,24 +499,35 @@ void power_event(void) {
 
     // Read power switch state
     static bool ps_last = true;
+    static bool ps_debounce = false;
+    static uint16_t ps_debounce_time = 0;
     bool ps_new = gpio_get(&PWR_SW_N);
-    if (!ps_new && ps_last) {
-        // Ensure press is not spurious
-        for (uint8_t i = 100; i != 0; i--) {
-            delay_ms(1);
-            if (gpio_get(&PWR_SW_N) != ps_new) {
-                DEBUG("%02X: Spurious press\n", main_cycle);
-                ps_new = ps_last;
-                break;
-            } else if (power_button_disabled()) {
-                // Ignore press when power button disabled
-                ps_new = ps_last;
-                break;
-            }
+    if (power_sequencing()) {
+        // Ignore the switch until power_on is done, so a press that is still
+        // held is not sent to the PCH as a second press
+        ps_debounce = false;
+        ps_new = ps_last;
+    } else if (!ps_new && ps_last) {
+        // Ensure press is not spurious, by checking it on later passes
+        uint16_t time = time_get_fast();
+        if (!ps_debounce) {
+            ps_debounce = true;
+            ps_debounce_time = time;
         }
 
-        if (ps_new != ps_last) {
+        if (power_button_disabled()) {
+            // Ignore press when power button disabled
+            ps_debounce = false;
+            ps_new = ps_last;
+        } else if ((time - ps_debounce_time) < POWER_SWITCH_DEBOUNCE) {
+            // Not confirmed yet
+            ps_new = ps_last;
+        } else {
+            ps_debounce = false;
+
             DEBUG("%02X: Power switch press\n", main_cycle);
+            power_trace(POWER_TRACE_PWR_SW_N, false);
+            boot_mark(BOOT_MARK_POWER_BUTTON);
 
             // Enable S5 power if necessary, before sending PWR_BTN
             update_power_state();
@@ -426,25 +540,32 @@ void power_event(void) {
                 ps_new = ps_last;
             }
         }
+    } else if (ps_debounce) {
+        // Released before the press was confirmed
+        DEBUG("%02X: Spurious press\n", main_cycle);
+        ps_debounce = false;
+    }
+    else if (ps_new && !ps_last) {
+        DEBUG("%02X: Power switch release\n", main_cycle);
+        power_trace(POWER_TRACE_PWR_SW_N, true);
     }
-    #if LEVEL >= LEVEL_DEBUG
-        else if (ps_new && !ps_last) {
-            DEBUG("%02X: Power switch release\n", main_cycle);
-        }
-    #endif
     ps_last = ps_new;
 
-    // Send power signal to PCH
-    gpio_set(&PWR_BTN_N, ps_new);
+    // Send power signal to PCH, unless power_on is driving it
+    if (!power_sequencing()) {
+        gpio_set(&PWR_BTN_N, ps_new);
+    }
 
     // Update power state before determining actions
     update_power_state();
 
     // If system power is good
     static bool pg_last = false;
+    static struct Async pg_async = { 0 };
     bool pg_new = gpio_get(&ALL_SYS_PWRGD);
     if (pg_new && !pg_last) {
         DEBUG("%02X: ALL_SYS_PWRGD asserted\n", main_cycle);
+        power_trace(POWER_TRACE_ALL_SYS_PWRGD, true);
 
         //TODO: tPLT04;
 
@@ -454,14 +575,13 @@ void power_event(void) {
 #endif // HAVE_PM_PWROK
 
         // OEM defined delay from ALL_SYS_PWRGD to SYS_PWROK - TODO
-        delay_ms(10);
-
-#if HAVE_PCH_PWROK_EC
-        // Assert SYS_PWROK, system can finally perform PLT_RST# and boot
-        GPIO_SET_DEBUG(PCH_PWROK_EC, true);
-#endif // HAVE_PCH_PWROK_EC
+        async_delay(&pg_async, PG_STEP_SYS_PWROK, 10);
     } else if(!pg_new && pg_last) {
         DEBUG("%02X: ALL_SYS_PWRGD de-asserted\n", main_cycle);
+        power_trace(POWER_TRACE_ALL_SYS_PWRGD, false);
+
+        // Do not assert SYS_PWROK if still waiting
+        async_cancel(&pg_async);
 
 #if HAVE_PCH_PWROK_EC
         // De-assert SYS_PWROK
@@ -475,15 +595,22 @@ void power_event(void) {
     }
     pg_last = pg_new;
 
+    if (async_poll(&pg_async) == PG_STEP_SYS_PWROK) {
+#if HAVE_PCH_PWROK_EC
+        // Assert SYS_PWROK, system can finally perform PLT_RST# and boot
+        GPIO_SET_DEBUG(PCH_PWROK_EC, true);
+#endif // HAVE_PCH_PWROK_EC
+    }
+
     static bool rst_last = false;
     bool rst_new = gpio_get(&BUF_PLT_RST_N);
-    #if LEVEL >= LEVEL_DEBUG
-        if (!rst_new && rst_last) {
-            DEBUG("%02X: PLT_RST# asserted\n", main_cycle);
-        } else
-    #endif
-    if(rst_new && !rst_last) {
+    if (!rst_new && rst_last) {
+        DEBUG("%02X: PLT_RST# asserted\n", main_cycle);
+        power_trace(POWER_TRACE_BUF_PLT_RST_N, false);
+    } else if(rst_new && !rst_last) {
         DEBUG("%02X: PLT_RST# de-asserted\n", main_cycle);
+        power_trace(POWER_TRACE_BUF_PLT_RST_N, true);
+        boot_mark(BOOT_MARK_PLT_RST);
 #if EC_ESPI
         espi_reset();
 #else // EC_ESPI
@@ -493,16 +620,16 @@ void power_event(void) {
     rst_last = rst_new;
 
 #if HAVE_SLP_SUS_N
-    #if LEVEL >= LEVEL_DEBUG
-        static bool sus_last = true;
-        bool sus_new = gpio_get(&SLP_SUS_N);
-        if (!sus_new && sus_last) {
-            DEBUG("%02X: SLP_SUS# asserted\n", main_cycle);
-        } else if (sus_new && !sus_last) {
-            DEBUG("%02X: SLP_SUS# de-asserted\n", main_cycle);
-        }
-        sus_last = sus_new;
-    #endif
+    static bool sus_last = true;
+    bool sus_new = gpio_get(&SLP_SUS_N);
+    if (!sus_new && sus_last) {
+        DEBUG("%02X: SLP_SUS# asserted\n", main_cycle);
+        power_trace(POWER_TRACE_SLP_SUS_N, false);
+    } else if (sus_new && !sus_last) {
+        DEBUG("%02X: SLP_SUS# de-asserted\n", main_cycle);
+        power_trace(POWER_TRACE_SLP_SUS_N, true);
+    }
+    sus_last = sus_new;
 #endif // HAVE_SLP_SUS_N
 
 #if EC_ESPI
@@ -512,20 +639,20 @@ void power_event(void) {
     // state is S3
     static bool ack_last = false;
     bool ack_new = gpio_get(&SUSWARN_N);
-    #if LEVEL >= LEVEL_DEBUG
-        if (ack_new && !ack_last) {
-            DEBUG("%02X: SUSPWRDNACK asserted\n", main_cycle);
-        } else if (!ack_new && ack_last) {
-            DEBUG("%02X: SUSPWRDNACK de-asserted\n", main_cycle);
-        }
-    #endif
+    if (ack_new && !ack_last) {
+        DEBUG("%02X: SUSPWRDNACK asserted\n", main_cycle);
+        power_trace(POWER_TRACE_SUSWARN_N, true);
+    } else if (!ack_new && ack_last) {
+        DEBUG("%02X: SUSPWRDNACK de-asserted\n", main_cycle);
+        power_trace(POWER_TRACE_SUSWARN_N, false);
+    }
     ack_last = ack_new;
 
     if (ack_new)
 #endif // HAVE_SUSWARN_N
     {
-        // Disable S5 power plane if not needed
-        if (power_state == POWER_STATE_S5) {
+        // Disable S5 power plane if not needed, and not powering on
+        if (power_state == POWER_STATE_S5 && !power_sequencing()) {
             power_off();
         }
     }
@@ -536,28 +663,23 @@ void power_event(void) {
     if (!wake_new && wake_last) {
         update_power_state();
         DEBUG("%02X: LAN_WAKEUP# asserted\n", main_cycle);
-        if (power_state == POWER_STATE_OFF) {
+        power_trace(POWER_TRACE_LAN_WAKEUP_N, false);
+        if (power_state == POWER_STATE_OFF && !power_sequencing()) {
             power_on();
         }
     }
-    #if LEVEL >= LEVEL_DEBUG
-        else if (wake_new && !wake_last) {
-            DEBUG("%02X: LAN_WAKEUP# de-asserted\n", main_cycle);
-        }
-    #endif
+    else if (wake_new && !wake_last) {
+        DEBUG("%02X: LAN_WAKEUP# de-asserted\n", main_cycle);
+        power_trace(POWER_TRACE_LAN_WAKEUP_N, true);
+    }
     wake_last = wake_new;
 #endif // HAVE_LAN_WAKEUP_N
 
-    static uint32_t last_time = 0;
-    uint32_t time = time_get();
     if (power_state == POWER_STATE_S0) {
 #if USE_S0IX
         if (!gpio_get(&SLP_S0_N)) {
             // Modern suspend, flashing green light
-            if ((time - last_time) >= 1000) {
-                gpio_set(&LED_PWR, !gpio_get(&LED_PWR));
-                last_time = time;
-            }
+            gpio_set(&LED_PWR, power_blink);
             gpio_set(&LED_ACIN, false);
         } else
 #endif
@@ -568,10 +690,7 @@ void power_event(void) {
         }
     } else if (power_state == POWER_STATE_S3) {
         // Suspended, flashing green light
-        if ((time - last_time) >= 1000) {
-            gpio_set(&LED_PWR, !gpio_get(&LED_PWR));
-            last_time = time;
-        }
+        gpio_set(&LED_PWR, power_blink);
         gpio_set(&LED_ACIN, false);
     } else if (!ac_new) {
         // AC plugged in, orange light
@@ -580,14 +699,13 @@ void power_event(void) {
     } else {
         // CPU off and AC adapter unplugged, flashing orange light
         gpio_set(&LED_PWR, false);
-        if ((time - last_time) >= 1000) {
-            gpio_set(&LED_ACIN, !gpio_get(&LED_ACIN));
-            last_time = time;
-        }
+        gpio_set(&LED_ACIN, power_blink);
 
 #if HAVE_XLP_OUT
         // Power off VDD3 if system should be off
-        gpio_set(&XLP_OUT, 0);
+        if (!power_sequencing()) {
+            gpio_set(&XLP_OUT, 0);
+        }
 #endif // HAVE_XLP_OUT
     }
 
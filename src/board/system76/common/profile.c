@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <board/profile.h>
+
+#if PROFILE
+
+#include <arch/time.h>
+#include <common/macro.h>
+
+static struct ProfileStats profile_stats[PROFILE_COUNT];
+
+void profile_record(enum ProfileTask task, uint32_t start) {
+    uint32_t ticks = time_get_ticks() - start;
+    struct ProfileStats * stats = &profile_stats[task];
+    if (stats->count == 0 || ticks < stats->min) {
+        stats->min = ticks;
+    }
+    if (ticks > stats->max) {
+        stats->max = ticks;
+    }
+    stats->total += ticks;
+    stats->count++;
+}
+
+bool profile_get(uint8_t index, struct ProfileStats * stats) {
+    if (index >= ARRAY_SIZE(profile_stats)) {
+        return false;
+    }
+    *stats = profile_stats[index];
+    return true;
+}
+
+void profile_reset(void) {
+    uint8_t i;
+    for (i = 0; i < ARRAY_SIZE(profile_stats); i++) {
+        profile_stats[i].min = 0;
+        profile_stats[i].max = 0;
+        profile_stats[i].total = 0;
+        profile_stats[i].count = 0;
+    }
+}
+
+#endif // PROFILE
@@ -13,14 +13,22 @@
 // the command is complete and the result is available. The client should only
 // read the SMFI_CMD_RES value when SMFI_CMD_CMD is set to CMD_NONE.
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
 #ifndef __SCRATCH__
     #include <board/scratch.h>
+    #include <board/battery.h>
+    #include <board/boot.h>
+    #include <board/dgpu.h>
     #include <board/kbled.h>
     #include <board/kbscan.h>
+    #include <board/peci.h>
+    #include <board/power.h>
+    #include <board/profile.h>
+    #include <ec/ec.h>
 #endif
 #include <board/smfi.h>
 #include <common/command.h>
@@ -67,8 +75,40 @@ static volatile uint8_t __xdata __at(0xE00) smfi_cmd[256];
 
 // Debug region - ring buffer of EC firmware prints
 #define SMFI_DBG_TAIL 0x00
+#define SMFI_DBG_WRAP 0x01
+#define SMFI_DBG_DATA 0x02
 static volatile uint8_t __xdata __at(0xF00) smfi_dbg[256];
 
+#if !defined(__SCRATCH__)
+// Telemetry region - snapshot of sensor values that the host can read without
+// sending a command. The sequence number is odd while the EC is updating it,
+// so the host should retry if it is odd or changes during a read. The layout
+// may only be extended at the end without changing SMFI_TLM_VERSION_1.
+#define SMFI_TLM_SEQUENCE 0x00
+#define SMFI_TLM_VERSION 0x01
+#define SMFI_TLM_SIZE 0x02
+#define SMFI_TLM_POWER_STATE 0x03
+#define SMFI_TLM_PECI_TEMP 0x04
+#define SMFI_TLM_DGPU_TEMP 0x06
+#define SMFI_TLM_FAN_DUTY 0x08
+#define SMFI_TLM_FAN_TACH 0x0A
+#define SMFI_TLM_BATTERY 0x0E
+#define SMFI_TLM_END 0x1E
+#define SMFI_TLM_VERSION_1 0x01
+static volatile uint8_t __xdata __at(0xC00) smfi_tlm[256];
+#endif // !defined(__SCRATCH__)
+
+#if defined(it5570e)
+// Log region - larger ring buffer of EC firmware prints, with a 16-bit tail
+// and wrap counter. Uses SRAM above the program, which is only free when the
+// scratch ROM is not mapped there (SCAR0 is in cache on it5570e)
+#define SMFI_LOG
+#define SMFI_LOG_TAIL 0x00
+#define SMFI_LOG_WRAP 0x02
+#define SMFI_LOG_DATA 0x04
+static volatile uint8_t __xdata __at(0x800) smfi_log[1024];
+#endif // defined(it5570e)
+
 #if !defined(__SCRATCH__)
 void smfi_init(void) {
     int16_t i;
@@ -87,6 +127,20 @@ void smfi_init(void) {
     // Clear tail last
     smfi_dbg[SMFI_DBG_TAIL] = 0x00;
 
+#if defined(SMFI_LOG)
+    // Clear log region
+    for (i = 0; i < ARRAY_SIZE(smfi_log); i++) {
+        smfi_log[i] = 0x00;
+    }
+
+    // H2RAM window 2 address 0x800 - 0xBFF, read-only
+    HRAMW2BA = 0x80;
+    HRAMW2AAS = 0x36;
+
+    // Enable H2RAM window 2 using LPC I/O
+    HRAMWC |= BIT(2);
+#endif // defined(SMFI_LOG)
+
     // H2RAM window 0 address 0xE00 - 0xEFF, read/write
     HRAMW0BA = 0xE0;
     HRAMW0AAS = 0x04;
@@ -95,8 +149,19 @@ void smfi_init(void) {
     HRAMW1BA = 0xF0;
     HRAMW1AAS = 0x34;
 
-    // Enable H2RAM window 0 and 1 using LPC I/O
-    HRAMWC |= BIT(4) | BIT(1) | BIT(0);
+    // Clear telemetry region, with an even sequence number
+    for (i = 0; i < ARRAY_SIZE(smfi_tlm); i++) {
+        smfi_tlm[i] = 0x00;
+    }
+    smfi_tlm[SMFI_TLM_VERSION] = SMFI_TLM_VERSION_1;
+    smfi_tlm[SMFI_TLM_SIZE] = SMFI_TLM_END;
+
+    // H2RAM window 3 address 0xC00 - 0xCFF, read-only
+    HRAMW3BA = 0xC0;
+    HRAMW3AAS = 0x34;
+
+    // Enable H2RAM window 0, 1, and 3 using LPC I/O
+    HRAMWC |= BIT(4) | BIT(3) | BIT(1) | BIT(0);
 
     // Enable backup ROM access
     FLHCTRL3 |= BIT(3);
@@ -243,14 +308,115 @@ static enum Result cmd_matrix_get(void) {
     }
     return RES_OK;
 }
+
+// Write a 32-bit little endian value to command data
+static void cmd_set_32(uint8_t index, uint32_t value) {
+    uint8_t i;
+    for (i = 0; i < 4; i++) {
+        smfi_cmd[SMFI_CMD_DATA + index + i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+static enum Result cmd_power_trace(void) {
+    uint8_t index = smfi_cmd[SMFI_CMD_DATA];
+    uint8_t flags = smfi_cmd[SMFI_CMD_DATA + 1];
+
+    smfi_cmd[SMFI_CMD_DATA + 1] = power_trace_count();
+
+    uint8_t i;
+    for (i = 0; i < CMD_POWER_TRACE_ENTRIES; i++) {
+        struct PowerTrace trace;
+        if (!power_trace_get(index + i, &trace)) {
+            break;
+        }
+        uint8_t offset = 3 + i * 6;
+        cmd_set_32(offset, trace.time);
+        smfi_cmd[SMFI_CMD_DATA + offset + 4] = trace.id;
+        smfi_cmd[SMFI_CMD_DATA + offset + 5] = trace.value;
+    }
+    smfi_cmd[SMFI_CMD_DATA + 2] = i;
+
+    if (flags & CMD_POWER_TRACE_FLAG_CLEAR) {
+        power_trace_clear();
+    }
+
+    return RES_OK;
+}
+
+static enum Result cmd_boot_get(void) {
+    uint8_t index = smfi_cmd[SMFI_CMD_DATA];
+
+    // Time of each mark, with a bit set in valid if it happened
+    uint8_t valid = 0;
+    uint8_t mark;
+    for (mark = 0; mark < BOOT_MARK_COUNT; mark++) {
+        uint32_t time = 0;
+        if (boot_mark_get(mark, &time)) {
+            valid |= BIT(mark);
+        }
+        cmd_set_32(2 + mark * 4, time);
+    }
+
+    // First POST code since the power button, with the bit after the marks
+    struct EcPost post;
+    if (ec_post_first(&post)) {
+        valid |= BIT(BOOT_MARK_COUNT);
+    } else {
+        post.time = 0;
+        post.code = 0;
+    }
+    smfi_cmd[SMFI_CMD_DATA + 1] = valid;
+    cmd_set_32(14, post.time);
+    smfi_cmd[SMFI_CMD_DATA + 18] = (uint8_t)post.code;
+    smfi_cmd[SMFI_CMD_DATA + 19] = (uint8_t)(post.code >> 8);
+
+    // Most recent POST codes, starting at index
+    smfi_cmd[SMFI_CMD_DATA + 20] = ec_post_count();
+    uint8_t i;
+    for (i = 0; i < CMD_BOOT_POST_ENTRIES; i++) {
+        if (!ec_post_get(index + i, &post)) {
+            break;
+        }
+        uint8_t offset = 22 + i * 6;
+        cmd_set_32(offset, post.time);
+        smfi_cmd[SMFI_CMD_DATA + offset + 4] = (uint8_t)post.code;
+        smfi_cmd[SMFI_CMD_DATA + offset + 5] = (uint8_t)(post.code >> 8);
+    }
+    smfi_cmd[SMFI_CMD_DATA + 21] = i;
+
+    return RES_OK;
+}
+
+#if PROFILE
+
+static enum Result cmd_profile_get(void) {
+    uint8_t index = smfi_cmd[SMFI_CMD_DATA];
+    uint8_t flags = smfi_cmd[SMFI_CMD_DATA + 1];
+
+    struct ProfileStats stats;
+    if (!profile_get(index, &stats)) {
+        return RES_ERR;
+    }
+
+    smfi_cmd[SMFI_CMD_DATA + 1] = PROFILE_COUNT;
+    cmd_set_32(2, stats.min);
+    cmd_set_32(6, stats.max);
+    cmd_set_32(10, stats.total);
+    cmd_set_32(14, stats.count);
+
+    if (flags & CMD_PROFILE_FLAG_RESET) {
+        profile_reset();
+    }
+
+    return RES_OK;
+}
+#endif // PROFILE
 #endif // !defined(__SCRATCH__)
 
 #if defined(__SCRATCH__)
-static enum Result cmd_spi_scratch(void) __critical {
-    uint8_t flags = smfi_cmd[SMFI_CMD_DATA];
-    uint8_t len = smfi_cmd[SMFI_CMD_DATA + 1];
-
-    // Enable chip
+// Enter follow mode and select the SPI chip
+static void spi_enable(uint8_t flags) {
     if (flags & CMD_SPI_FLAG_BACKUP) {
         ECINDAR3 = 0xFF;
     } else {
@@ -259,6 +425,49 @@ static enum Result cmd_spi_scratch(void) __critical {
     ECINDAR2 = 0xFF;
     ECINDAR1 = 0xFD;
     ECINDAR0 = 0x00;
+}
+
+// Deselect the SPI chip
+static void spi_disable(void) {
+    ECINDAR1 = 0xFE;
+    ECINDDR = 0;
+}
+
+// Send a single byte instruction to the SPI chip
+static void spi_instruction(uint8_t flags, uint8_t instruction) {
+    spi_enable(flags);
+    ECINDDR = instruction;
+    spi_disable();
+}
+
+// Status reads before giving up, well beyond the longest page program time
+#define SPI_STATUS_TRIES 0xFFFF
+
+// Wait for the SPI status register to have mask bits set to value, returns
+// false if the chip never got there
+static bool spi_status_wait(uint8_t flags, uint8_t mask, uint8_t value) {
+    uint16_t tries = SPI_STATUS_TRIES;
+    bool ok = true;
+
+    spi_enable(flags);
+    ECINDDR = 0x05;
+    while ((ECINDDR & mask) != value) {
+        if (--tries == 0) {
+            ok = false;
+            break;
+        }
+    }
+    spi_disable();
+
+    return ok;
+}
+
+static enum Result cmd_spi_scratch(void) __critical {
+    uint8_t flags = smfi_cmd[SMFI_CMD_DATA];
+    uint8_t len = smfi_cmd[SMFI_CMD_DATA + 1];
+
+    // Enable chip
+    spi_enable(flags);
 
     // Read or write len bytes
     uint8_t i;
@@ -275,12 +484,129 @@ static enum Result cmd_spi_scratch(void) __critical {
 
     if (flags & CMD_SPI_FLAG_DISABLE) {
         // Disable chip
-        ECINDAR1 = 0xFE;
-        ECINDDR = 0;
+        spi_disable();
+    }
+
+    return RES_OK;
+}
+
+// CRC32 (IEEE 802.3) table indexed by nibble, small enough for scratch ROM
+static const uint32_t __code crc32_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+static enum Result cmd_spi_crc32(void) __critical {
+    uint8_t flags = smfi_cmd[SMFI_CMD_DATA];
+    uint32_t len =
+        ((uint32_t)smfi_cmd[SMFI_CMD_DATA + 4]) |
+        (((uint32_t)smfi_cmd[SMFI_CMD_DATA + 5]) << 8) |
+        (((uint32_t)smfi_cmd[SMFI_CMD_DATA + 6]) << 16);
+    uint32_t crc = 0xFFFFFFFF;
+
+    // Enable chip
+    spi_enable(flags);
+
+    // Fast read from address, followed by a dummy byte
+    ECINDDR = 0x0B;
+    ECINDDR = smfi_cmd[SMFI_CMD_DATA + 3];
+    ECINDDR = smfi_cmd[SMFI_CMD_DATA + 2];
+    ECINDDR = smfi_cmd[SMFI_CMD_DATA + 1];
+    ECINDDR = 0x00;
+
+    while (len) {
+        uint8_t byte = ECINDDR;
+        crc = crc32_table[((uint8_t)crc ^ byte) & 0xF] ^ (crc >> 4);
+        crc = crc32_table[((uint8_t)crc ^ (byte >> 4)) & 0xF] ^ (crc >> 4);
+        len--;
     }
 
+    // Disable chip
+    spi_disable();
+
+    crc = ~crc;
+    smfi_cmd[SMFI_CMD_DATA + 7] = (uint8_t)crc;
+    smfi_cmd[SMFI_CMD_DATA + 8] = (uint8_t)(crc >> 8);
+    smfi_cmd[SMFI_CMD_DATA + 9] = (uint8_t)(crc >> 16);
+    smfi_cmd[SMFI_CMD_DATA + 10] = (uint8_t)(crc >> 24);
+
     return RES_OK;
 }
+
+static enum Result spi_program(uint8_t flags, uint8_t len) {
+    uint8_t i;
+
+    // Write enable, poll status for busy unset and write enable set
+    spi_instruction(flags, 0x06);
+    if (!spi_status_wait(flags, 3, 2)) {
+        return RES_ERR;
+    }
+
+    if (flags & CMD_SPI_FLAG_BACKUP) {
+        // Page program, chunk must not cross a page boundary
+        spi_enable(flags);
+        ECINDDR = 0xF2;
+        ECINDDR = smfi_cmd[SMFI_CMD_DATA + 4];
+        ECINDDR = smfi_cmd[SMFI_CMD_DATA + 3];
+        ECINDDR = smfi_cmd[SMFI_CMD_DATA + 2];
+        for (i = 0; i < len; i++) {
+            ECINDDR = smfi_cmd[i + SMFI_CMD_DATA + 5];
+        }
+        spi_disable();
+
+        // Poll status for busy unset
+        if (!spi_status_wait(flags, 1, 0)) {
+            return RES_ERR;
+        }
+    } else {
+        // AAI word program, odd length is padded with 0xFF
+        for (i = 0; i < len; i += 2) {
+            spi_enable(flags);
+            ECINDDR = 0xAD;
+            if (i == 0) {
+                ECINDDR = smfi_cmd[SMFI_CMD_DATA + 4];
+                ECINDDR = smfi_cmd[SMFI_CMD_DATA + 3];
+                ECINDDR = smfi_cmd[SMFI_CMD_DATA + 2];
+            }
+            ECINDDR = smfi_cmd[i + SMFI_CMD_DATA + 5];
+            if ((i + 1) < len) {
+                ECINDDR = smfi_cmd[i + SMFI_CMD_DATA + 6];
+            } else {
+                ECINDDR = 0xFF;
+            }
+            spi_disable();
+
+            // Poll status for busy unset
+            if (!spi_status_wait(flags, 1, 0)) {
+                return RES_ERR;
+            }
+        }
+    }
+
+    return RES_OK;
+}
+
+static enum Result cmd_spi_program(void) __critical {
+    uint8_t flags = smfi_cmd[SMFI_CMD_DATA];
+    uint8_t len = smfi_cmd[SMFI_CMD_DATA + 1];
+
+    if ((len + SMFI_CMD_DATA + 5) > ARRAY_SIZE(smfi_cmd)) {
+        return RES_ERR;
+    }
+
+    enum Result result = spi_program(flags, len);
+
+    // Write disable even after a failure, poll status for busy unset and
+    // write enable unset
+    spi_instruction(flags, 0x04);
+    if (!spi_status_wait(flags, 3, 0)) {
+        result = RES_ERR;
+    }
+
+    return result;
+}
 #endif // defined(__SCRATCH__)
 
 static enum Result cmd_spi(void) {
@@ -327,6 +653,13 @@ void smfi_event(void) {
                 smfi_cmd[SMFI_CMD_DATA + 1] = 0xEC;
                 // Version
                 smfi_cmd[SMFI_CMD_DATA + 2] = 0x01;
+                // Capabilities
+                smfi_cmd[SMFI_CMD_DATA + 3] = CMD_PROBE_FLAG_DEBUG_WRAP
+                    | CMD_PROBE_FLAG_TELEMETRY
+#if defined(SMFI_LOG)
+                    | CMD_PROBE_FLAG_DEBUG_LOG
+#endif
+                    ;
                 //TODO: bitmask of implemented commands?
                 // Always successful
                 smfi_cmd[SMFI_CMD_RES] = RES_OK;
@@ -371,10 +704,29 @@ void smfi_event(void) {
             case CMD_MATRIX_GET:
                 smfi_cmd[SMFI_CMD_RES] = cmd_matrix_get();
                 break;
+            case CMD_POWER_TRACE:
+                smfi_cmd[SMFI_CMD_RES] = cmd_power_trace();
+                break;
+            case CMD_BOOT_GET:
+                smfi_cmd[SMFI_CMD_RES] = cmd_boot_get();
+                break;
+#if PROFILE
+            case CMD_PROFILE_GET:
+                smfi_cmd[SMFI_CMD_RES] = cmd_profile_get();
+                break;
+#endif // PROFILE
 #endif // !defined(__SCRATCH__)
             case CMD_SPI:
                 smfi_cmd[SMFI_CMD_RES] = cmd_spi();
                 break;
+#if defined(__SCRATCH__)
+            case CMD_SPI_CRC32:
+                smfi_cmd[SMFI_CMD_RES] = cmd_spi_crc32();
+                break;
+            case CMD_SPI_PROGRAM:
+                smfi_cmd[SMFI_CMD_RES] = cmd_spi_program();
+                break;
+#endif // defined(__SCRATCH__)
             case CMD_RESET:
                 smfi_cmd[SMFI_CMD_RES] = cmd_reset();
                 break;
@@ -389,12 +741,86 @@ void smfi_event(void) {
     }
 }
 
+#if !defined(__SCRATCH__)
+static void smfi_telemetry_16(uint8_t index, uint16_t value) {
+    smfi_tlm[index] = (uint8_t)value;
+    smfi_tlm[index + 1] = (uint8_t)(value >> 8);
+}
+
+void smfi_telemetry(void) {
+    // Odd sequence number while updating
+    smfi_tlm[SMFI_TLM_SEQUENCE]++;
+
+    smfi_tlm[SMFI_TLM_POWER_STATE] = (uint8_t)power_state;
+    smfi_telemetry_16(SMFI_TLM_PECI_TEMP, (uint16_t)peci_temp);
+    smfi_tlm[SMFI_TLM_FAN_DUTY] = DCR2;
+    smfi_tlm[SMFI_TLM_FAN_TACH] = F1TLRR;
+    smfi_tlm[SMFI_TLM_FAN_TACH + 1] = F1TMRR;
+#if HAVE_DGPU
+    smfi_telemetry_16(SMFI_TLM_DGPU_TEMP, (uint16_t)dgpu_temp);
+    smfi_tlm[SMFI_TLM_FAN_DUTY + 1] = DCR4;
+    smfi_tlm[SMFI_TLM_FAN_TACH + 2] = F2TLRR;
+    smfi_tlm[SMFI_TLM_FAN_TACH + 3] = F2TMRR;
+#endif // HAVE_DGPU
+    smfi_telemetry_16(SMFI_TLM_BATTERY + 0, battery_info.temp);
+    smfi_telemetry_16(SMFI_TLM_BATTERY + 2, battery_info.voltage);
+    smfi_telemetry_16(SMFI_TLM_BATTERY + 4, battery_info.current);
+    smfi_telemetry_16(SMFI_TLM_BATTERY + 6, battery_info.charge);
+    smfi_telemetry_16(SMFI_TLM_BATTERY + 8, battery_info.remaining_capacity);
+    smfi_telemetry_16(SMFI_TLM_BATTERY + 10, battery_info.full_capacity);
+    smfi_telemetry_16(SMFI_TLM_BATTERY + 12, battery_info.status);
+    smfi_telemetry_16(SMFI_TLM_BATTERY + 14, battery_info.cycle_count);
+
+    // Even sequence number when done
+    smfi_tlm[SMFI_TLM_SEQUENCE]++;
+}
+#endif // !defined(__SCRATCH__)
+
+#if defined(SMFI_LOG)
+static void smfi_log_write(uint8_t byte) {
+    uint16_t tail =
+        ((uint16_t)smfi_log[SMFI_LOG_TAIL]) |
+        (((uint16_t)smfi_log[SMFI_LOG_TAIL + 1]) << 8);
+    tail++;
+    if (tail < SMFI_LOG_DATA) {
+        tail = SMFI_LOG_DATA;
+    }
+    if (tail >= ARRAY_SIZE(smfi_log)) {
+        tail = SMFI_LOG_DATA;
+        smfi_log[tail] = byte;
+        // Count wraps so the host can detect overwritten output
+        uint16_t wrap =
+            ((uint16_t)smfi_log[SMFI_LOG_WRAP]) |
+            (((uint16_t)smfi_log[SMFI_LOG_WRAP + 1]) << 8);
+        wrap++;
+        smfi_log[SMFI_LOG_WRAP] = (uint8_t)wrap;
+        smfi_log[SMFI_LOG_WRAP + 1] = (uint8_t)(wrap >> 8);
+    } else {
+        smfi_log[tail] = byte;
+    }
+    smfi_log[SMFI_LOG_TAIL] = (uint8_t)tail;
+    smfi_log[SMFI_LOG_TAIL + 1] = (uint8_t)(tail >> 8);
+}
+#endif // defined(SMFI_LOG)
+
 void smfi_debug(uint8_t byte) {
+#if defined(SMFI_LOG)
+    smfi_log_write(byte);
+#endif
+
     int16_t tail = (int16_t)smfi_dbg[SMFI_DBG_TAIL];
     tail++;
+    if (tail < SMFI_DBG_DATA) {
+        tail = SMFI_DBG_DATA;
+    }
     if (tail >= ARRAY_SIZE(smfi_dbg)) {
-        tail = SMFI_DBG_TAIL + 1;
+        tail = SMFI_DBG_DATA;
+        smfi_dbg[tail] = byte;
+        // Count wraps so the host can detect overwritten output, updated
+        // right before the tail to keep the window where they disagree short
+        smfi_dbg[SMFI_DBG_WRAP]++;
+    } else {
+        smfi_dbg[tail] = byte;
     }
-    smfi_dbg[tail] = byte;
     smfi_dbg[SMFI_DBG_TAIL] = (uint8_t)tail;
 }
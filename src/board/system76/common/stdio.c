@@ -3,6 +3,7 @@
 #include <stdio.h>
 
 #include <board/smfi.h>
+#include <board/stdio.h>
 
 #ifdef SERIAL_DEBUGGER
     #include <mcs51/8051.h>
@@ -16,24 +17,114 @@
     #include <board/parallel.h>
 #endif // PARALLEL_DEBUG
 
-int putchar(int c) {
-    uint8_t byte = (uint8_t)c;
+#if defined(I2C_DEBUGGER) || defined(PARALLEL_DEBUG)
+// Output to slow sinks is buffered by putchar and drained by stdio_event, so
+// that logging does not change the timing of the caller
+#define STDIO_BUFFER
+#define STDIO_BUFFER_SIZE 128
+// Maximum bytes sent to the sinks per call of stdio_event
+#define STDIO_DRAIN_SIZE 16
 
-    smfi_debug(byte);
+// Room needed for the longest overrun marker, "\n[lost 65535 bytes]\n"
+#define STDIO_OVERRUN_SIZE 20
 
-#ifdef SERIAL_DEBUGGER
-    SBUF = byte;
-#endif
+static uint8_t stdio_buffer[STDIO_BUFFER_SIZE];
+static uint8_t stdio_head = 0;
+static uint8_t stdio_tail = 0;
+// Bytes dropped since the last overrun marker
+static uint16_t stdio_dropped = 0;
+
+static uint8_t stdio_free(void) {
+    return (uint8_t)((stdio_head + STDIO_BUFFER_SIZE - stdio_tail - 1) % STDIO_BUFFER_SIZE);
+}
+
+static void stdio_put(uint8_t byte) {
+    stdio_buffer[stdio_tail] = byte;
+    stdio_tail = (stdio_tail + 1) % STDIO_BUFFER_SIZE;
+}
+
+static void stdio_put_str(const char * str) {
+    while (*str) {
+        stdio_put((uint8_t)*str++);
+    }
+}
+
+static void stdio_push(uint8_t byte) {
+    if (stdio_dropped) {
+        // Mark the gap in the output once there is room for the marker
+        if (stdio_free() <= STDIO_OVERRUN_SIZE) {
+            if (stdio_dropped < 0xFFFF) {
+                stdio_dropped++;
+            }
+            return;
+        }
+
+        uint8_t digits[5];
+        uint8_t count = 0;
+        uint16_t value = stdio_dropped;
+        do {
+            digits[count++] = '0' + (value % 10);
+            value /= 10;
+        } while (value);
+
+        stdio_put_str("\n[lost ");
+        while (count) {
+            stdio_put(digits[--count]);
+        }
+        stdio_put_str(" bytes]\n");
+        stdio_dropped = 0;
+    }
+
+    // Drop output if the sinks cannot keep up
+    if (stdio_free() == 0) {
+        stdio_dropped = 1;
+        return;
+    }
+    stdio_put(byte);
+}
+#endif // defined(I2C_DEBUGGER) || defined(PARALLEL_DEBUG)
+
+void stdio_event(void) {
+#if defined(STDIO_BUFFER)
+    uint8_t head = stdio_head;
+    uint8_t tail = stdio_tail;
+    if (head == tail) {
+        return;
+    }
+
+    // Send a contiguous part of the buffer
+    uint8_t length = ((tail > head) ? tail : STDIO_BUFFER_SIZE) - head;
+    if (length > STDIO_DRAIN_SIZE) {
+        length = STDIO_DRAIN_SIZE;
+    }
 
 #ifdef I2C_DEBUGGER
-    i2c_send(&I2C_SMBUS, I2C_DEBUGGER, &byte, 1);
+    i2c_send(&I2C_SMBUS, I2C_DEBUGGER, &stdio_buffer[head], length);
 #endif
 
 #ifdef PARALLEL_DEBUG
     if (parallel_debug) {
-        parallel_write(&byte, 1);
+        parallel_write(&stdio_buffer[head], length);
     }
 #endif // PARALLEL_DEBUG
 
+    // Bytes are dropped if a sink timed out, rather than retried
+    stdio_head = (head + length) % STDIO_BUFFER_SIZE;
+#endif // defined(STDIO_BUFFER)
+}
+
+int putchar(int c) {
+    uint8_t byte = (uint8_t)c;
+
+    smfi_debug(byte);
+
+#ifdef SERIAL_DEBUGGER
+    SBUF = byte;
+#endif
+
+#if defined(STDIO_BUFFER)
+    stdio_push(byte);
+#endif
+
     return (int)byte;
 }
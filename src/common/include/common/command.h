@@ -46,6 +46,16 @@ enum Command {
     CMD_LED_SAVE = 18,
     // Enable/disable no input mode
     CMD_SET_NO_INPUT = 19,
+    // Calculate CRC32 of a SPI chip range, only in scratch ROM
+    CMD_SPI_CRC32 = 20,
+    // Program a chunk of a SPI chip, only in scratch ROM
+    CMD_SPI_PROGRAM = 21,
+    // Get main loop task durations, only if built with PROFILE=1
+    CMD_PROFILE_GET = 22,
+    // Read timestamped power sequencing signal changes
+    CMD_POWER_TRACE = 23,
+    // Read boot timing marks and timestamped POST codes
+    CMD_BOOT_GET = 24,
     //TODO
 };
 
@@ -68,6 +78,31 @@ enum CommandSpiFlag {
     CMD_SPI_FLAG_BACKUP = BIT(3),
 };
 
+enum CommandProbeFlag {
+    // Debug region has a wrap counter before the ring data
+    CMD_PROBE_FLAG_DEBUG_WRAP = BIT(0),
+    // Log region at 0x800 - 0xBFF has a larger copy of the debug ring
+    CMD_PROBE_FLAG_DEBUG_LOG = BIT(1),
+    // Telemetry region at 0xC00 - 0xCFF has a snapshot of sensor values
+    CMD_PROBE_FLAG_TELEMETRY = BIT(2),
+};
+
+enum CommandProfileFlag {
+    // Clear all task durations after reading
+    CMD_PROFILE_FLAG_RESET = BIT(0),
+};
+
+enum CommandPowerTraceFlag {
+    // Clear the trace after reading
+    CMD_POWER_TRACE_FLAG_CLEAR = BIT(0),
+};
+
+// Maximum number of power trace entries returned by one command
+#define CMD_POWER_TRACE_ENTRIES 8
+
+// Maximum number of POST codes returned by one boot command
+#define CMD_BOOT_POST_ENTRIES 8
+
 #define CMD_LED_INDEX_ALL 0xFF
 
 #endif // _COMMON_COMMAND_H
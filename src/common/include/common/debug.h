@@ -17,14 +17,23 @@
     #define LEVEL LEVEL_INFO
 #endif
 
+// Tokenize the frequent TRACE and DEBUG output if enabled, except in the
+// scratch and flash ROMs, which do not link the log functions
+#if defined(LOG_TOKENS) && !defined(__SCRATCH__) && !defined(__FLASH__)
+    #include <common/log.h>
+    #define DEBUG_PRINT(...) LOG_TOKEN(__VA_ARGS__)
+#else
+    #define DEBUG_PRINT(...) printf(__VA_ARGS__)
+#endif
+
 #if LEVEL >= LEVEL_TRACE
-    #define TRACE(...) printf(__VA_ARGS__)
+    #define TRACE(...) DEBUG_PRINT(__VA_ARGS__)
 #else
     #define TRACE(...)
 #endif
 
 #if LEVEL >= LEVEL_DEBUG
-    #define DEBUG(...) printf(__VA_ARGS__)
+    #define DEBUG(...) DEBUG_PRINT(__VA_ARGS__)
 #else
     #define DEBUG(...)
 #endif
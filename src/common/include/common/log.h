@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef _COMMON_LOG_H
+#define _COMMON_LOG_H
+
+#include <stdint.h>
+
+// Tokenized logging. Instead of formatting with printf, a call site emits
+// LOG_MARKER, its token, the argument count, and then the size and raw little
+// endian bytes of each argument. The token is the file ID and the index of
+// the call site in the file, from __COUNTER__, as one line may have several
+// call sites from a macro. Format strings are not stored in the firmware,
+// ectool decodes the output with the dictionary generated by
+// scripts/log_dict.sh.
+#define LOG_MARKER 0xFF
+
+// File ID, set for each source file by the build
+#ifndef LOG_FILE
+    #define LOG_FILE 0
+#endif
+
+void log_begin(uint8_t file, uint16_t index, uint8_t count);
+void log_arg(uint32_t value, uint8_t size);
+
+#define LOG_CAT(A, B) LOG_CAT_(A, B)
+#define LOG_CAT_(A, B) A ## B
+
+// Count of arguments, including the format string, up to 8
+#define LOG_COUNT(...) LOG_COUNT_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+
+// Size of an argument, capped at 32 bits. A string literal argument has the
+// size of its array, but only its pointer is sent, which shows as <str>.
+#define LOG_SIZE(X) (sizeof(X) > sizeof(uint32_t) ? sizeof(uint32_t) : sizeof(X))
+
+// Emit each argument after the format string
+#define LOG_ARG(X) log_arg((uint32_t)(X), LOG_SIZE(X));
+#define LOG_ARGS_1(F)
+#define LOG_ARGS_2(F, X) LOG_ARG(X)
+#define LOG_ARGS_3(F, X, ...) LOG_ARG(X) LOG_ARGS_2(F, __VA_ARGS__)
+#define LOG_ARGS_4(F, X, ...) LOG_ARG(X) LOG_ARGS_3(F, __VA_ARGS__)
+#define LOG_ARGS_5(F, X, ...) LOG_ARG(X) LOG_ARGS_4(F, __VA_ARGS__)
+#define LOG_ARGS_6(F, X, ...) LOG_ARG(X) LOG_ARGS_5(F, __VA_ARGS__)
+#define LOG_ARGS_7(F, X, ...) LOG_ARG(X) LOG_ARGS_6(F, __VA_ARGS__)
+#define LOG_ARGS_8(F, X, ...) LOG_ARG(X) LOG_ARGS_7(F, __VA_ARGS__)
+
+#if defined(LOG_DICT)
+    // Only preprocessed, by scripts/log_dict.sh to find call sites
+    #define LOG_TOKEN(...) __log_dict__(LOG_FILE, __COUNTER__, __VA_ARGS__)
+#else
+    #define LOG_TOKEN(...) do { \
+        log_begin(LOG_FILE, __COUNTER__, LOG_COUNT(__VA_ARGS__) - 1); \
+        LOG_CAT(LOG_ARGS_, LOG_COUNT(__VA_ARGS__))(__VA_ARGS__) \
+    } while (0)
+#endif
+
+#endif // _COMMON_LOG_H
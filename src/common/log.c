@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#if defined(LOG_TOKENS)
+
+#include <stdio.h>
+
+#include <common/log.h>
+
+void log_begin(uint8_t file, uint16_t index, uint8_t count) {
+    putchar(LOG_MARKER);
+    putchar(file);
+    putchar((uint8_t)index);
+    putchar((uint8_t)(index >> 8));
+    putchar(count);
+}
+
+void log_arg(uint32_t value, uint8_t size) {
+    putchar(size);
+    while (size--) {
+        putchar((uint8_t)value);
+        value >>= 8;
+    }
+}
+
+#endif // defined(LOG_TOKENS)
@@ -1,10 +1,22 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <arch/time.h>
 #include <ec/ec.h>
 #include <ec/gctrl.h>
 #include <common/debug.h>
 #include <common/macro.h>
 
+#ifdef it5570e
+// Number of POST codes in the log, must be a power of two
+#define EC_POST_SIZE 16
+
+static struct EcPost ec_posts[EC_POST_SIZE];
+static uint8_t ec_post_head = 0;
+static uint8_t ec_post_len = 0;
+static struct EcPost ec_post_first_code;
+static bool ec_post_first_valid = false;
+#endif // it5570e
+
 void ec_init(void) {
 #ifdef it8587e
     RSTS = (0b10U << 6) | BIT(2);
@@ -24,6 +36,63 @@ void ec_read_post_codes(void) {
         P80H81HS |= 1;
 
         DEBUG("POST %02X%02X\n", p81h, p80h);
+
+        struct EcPost * post = &ec_posts[ec_post_head];
+        post->time = time_get();
+        post->code = ((uint16_t)p81h << 8) | p80h;
+        if (!ec_post_first_valid) {
+            ec_post_first_code = *post;
+            ec_post_first_valid = true;
+        }
+
+        // Overwrite the oldest code when full
+        ec_post_head = (ec_post_head + 1) & (EC_POST_SIZE - 1);
+        if (ec_post_len < EC_POST_SIZE) {
+            ec_post_len++;
+        }
+    }
+#endif
+}
+
+uint8_t ec_post_count(void) {
+#ifdef it5570e
+    return ec_post_len;
+#else
+    return 0;
+#endif
+}
+
+bool ec_post_get(uint8_t index, struct EcPost * post) {
+#ifdef it5570e
+    if (index < ec_post_len) {
+        *post = ec_posts[(ec_post_head - ec_post_len + index) & (EC_POST_SIZE - 1)];
+        return true;
     }
+#else
+    // Fix unused variables
+    index = index;
+    post = post;
+#endif
+    return false;
+}
+
+bool ec_post_first(struct EcPost * post) {
+#ifdef it5570e
+    if (ec_post_first_valid) {
+        *post = ec_post_first_code;
+        return true;
+    }
+#else
+    // Fix unused variable
+    post = post;
+#endif
+    return false;
+}
+
+void ec_post_clear(void) {
+#ifdef it5570e
+    ec_post_head = 0;
+    ec_post_len = 0;
+    ec_post_first_valid = false;
 #endif
 }
@@ -3,7 +3,25 @@
 #ifndef _EC_EC_H
 #define _EC_EC_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+// POST code from ports 80h and 81h, with the time it was read
+struct EcPost {
+    // Time in ms from time_get
+    uint32_t time;
+    uint16_t code;
+};
+
 void ec_init(void);
 void ec_read_post_codes(void);
 
+// Number of POST codes in the log, up to EC_POST_SIZE
+uint8_t ec_post_count(void);
+// Read a POST code from the log, with index 0 being the oldest
+bool ec_post_get(uint8_t index, struct EcPost * post);
+// First POST code since the log was cleared, which is kept if the log wraps
+bool ec_post_first(struct EcPost * post);
+void ec_post_clear(void);
+
 #endif // _EC_EC_H
@@ -73,16 +73,24 @@ impl<T: Timeout + Send> AccessLpcDirect<T> {
 
 impl<T: Timeout + Send> Access for AccessLpcDirect<T> {
     unsafe fn command(&mut self, cmd: u8, data: &mut [u8]) -> Result<u8, Error> {
+        let len = data.len();
+        self.command_len(cmd, data, len, len)
+    }
+
+    unsafe fn command_len(&mut self, cmd: u8, data: &mut [u8], request: usize, response: usize) -> Result<u8, Error> {
         // Test data length
         if data.len() > self.data_size() {
             return Err(Error::DataLength(data.len()));
         }
+        if request > data.len() || response > data.len() {
+            return Err(Error::Parameter);
+        }
 
         // All previous commands should be finished
         self.command_check()?;
 
-        // Write data bytes, index should be valid due to length test above
-        for i in 0..data.len() {
+        // Write request bytes, index should be valid due to length test above
+        for i in 0..request {
             self.write_cmd(i as u8 + SMFI_CMD_DATA, data[i]);
         }
 
@@ -93,8 +101,8 @@ impl<T: Timeout + Send> Access for AccessLpcDirect<T> {
         self.timeout.reset();
         timeout!(self.timeout, self.command_check())?;
 
-        // Read data bytes, index should be valid due to length test above
-        for i in 0..data.len() {
+        // Read response bytes, index should be valid due to length test above
+        for i in 0..response {
             data[i] = self.read_cmd(i as u8 + SMFI_CMD_DATA);
         }
 
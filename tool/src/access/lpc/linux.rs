@@ -2,14 +2,11 @@
 
 use std::{
     fs,
-    io::{
-        self,
-        Read,
-        Write,
-        Seek,
-        SeekFrom,
+    io,
+    os::unix::{
+        fs::FileExt,
+        io::AsRawFd,
     },
-    os::unix::io::AsRawFd,
     path::Path,
     time::Duration,
 };
@@ -64,34 +61,37 @@ impl PortLock {
         })
     }
 
-    fn seek(&mut self, offset: u16) -> io::Result<()> {
-        if offset >= self.len {
+    /// Return the port of a range of `len` bytes at `offset`, if it is inside the lock
+    fn port(&self, offset: u16, len: usize) -> io::Result<u64> {
+        if offset as usize + len > self.len as usize {
             return Err(io::Error::new(
                 io::ErrorKind::InvalidInput,
-                "PortLock::seek: offset >= len"
+                "PortLock::port: offset + len > lock len"
             ));
         }
-        let port = self.start + offset;
-        let pos = self.file.seek(SeekFrom::Start(port as u64))?;
-        if pos != port as u64 {
-            return Err(io::Error::new(
-                io::ErrorKind::UnexpectedEof,
-                "PortLock::seek: failed to seek to port"
-            ));
-        }
-        Ok(())
+        Ok(self.start as u64 + offset as u64)
+    }
+
+    /// Read a contiguous range of ports with a single syscall
+    pub fn read_at(&mut self, offset: u16, data: &mut [u8]) -> io::Result<()> {
+        let port = self.port(offset, data.len())?;
+        self.file.read_exact_at(data, port)
+    }
+
+    /// Write a contiguous range of ports with a single syscall
+    pub fn write_at(&mut self, offset: u16, data: &[u8]) -> io::Result<()> {
+        let port = self.port(offset, data.len())?;
+        self.file.write_all_at(data, port)
     }
 
     pub fn read(&mut self, offset: u16) -> io::Result<u8> {
-        self.seek(offset)?;
         let mut data = [0];
-        self.file.read_exact(&mut data)?;
+        self.read_at(offset, &mut data)?;
         Ok(data[0])
     }
 
     pub fn write(&mut self, offset: u16, value: u8) -> io::Result<()> {
-        self.seek(offset)?;
-        self.file.write_all(&[value])
+        self.write_at(offset, &[value])
     }
 }
 
@@ -99,6 +99,8 @@ impl PortLock {
 pub struct AccessLpcLinux {
     cmd: PortLock,
     dbg: PortLock,
+    // Only locked on first use, as not every EC maps this range
+    ram: Option<PortLock>,
     timeout: StdTimeout,
 }
 
@@ -118,6 +120,7 @@ impl AccessLpcLinux {
         Ok(Self {
             cmd,
             dbg,
+            ram: None,
             timeout: StdTimeout::new(timeout),
         })
     }
@@ -144,18 +147,24 @@ impl AccessLpcLinux {
 
 impl Access for AccessLpcLinux {
     unsafe fn command(&mut self, cmd: u8, data: &mut [u8]) -> Result<u8, Error> {
+        let len = data.len();
+        self.command_len(cmd, data, len, len)
+    }
+
+    unsafe fn command_len(&mut self, cmd: u8, data: &mut [u8], request: usize, response: usize) -> Result<u8, Error> {
         // Test data length
         if data.len() > self.data_size() {
             return Err(Error::DataLength(data.len()));
         }
+        if request > data.len() || response > data.len() {
+            return Err(Error::Parameter);
+        }
 
         // All previous commands should be finished
         self.command_check()?;
 
-        // Write data bytes, index should be valid due to length test above
-        for i in 0..data.len() {
-            self.write_cmd(i as u8 + SMFI_CMD_DATA, data[i])?;
-        }
+        // Write request bytes, range should be valid due to length test above
+        self.cmd.write_at(SMFI_CMD_DATA as u16, &data[..request])?;
 
         // Write command byte, which starts command
         self.write_cmd(SMFI_CMD_CMD, cmd as u8)?;
@@ -164,13 +173,14 @@ impl Access for AccessLpcLinux {
         self.timeout.reset();
         timeout!(self.timeout, self.command_check())?;
 
-        // Read data bytes, index should be valid due to length test above
-        for i in 0..data.len() {
-            data[i] = self.read_cmd(i as u8 + SMFI_CMD_DATA)?;
-        }
+        // Read result and response bytes together, as they are contiguous
+        let mut buffer = [0; SMFI_CMD_SIZE];
+        let result = &mut buffer[SMFI_CMD_RES as usize..SMFI_CMD_DATA as usize + response];
+        self.cmd.read_at(SMFI_CMD_RES as u16, result)?;
+        data[..response].copy_from_slice(&result[1..]);
 
-        // Return response byte
-        self.read_cmd(SMFI_CMD_RES)
+        // Return result byte
+        Ok(result[0])
     }
 
     fn data_size(&self) -> usize {
@@ -180,4 +190,17 @@ impl Access for AccessLpcLinux {
     unsafe fn read_debug(&mut self, addr: u8) -> Result<u8, Error> {
         Ok(self.dbg.read(addr as u16)?)
     }
+
+    unsafe fn read_debug_range(&mut self, addr: u8, data: &mut [u8]) -> Result<(), Error> {
+        Ok(self.dbg.read_at(addr as u16, data)?)
+    }
+
+    unsafe fn read_ram(&mut self, addr: u16, data: &mut [u8]) -> Result<(), Error> {
+        let offset = addr.checked_sub(SMFI_RAM_BASE).ok_or(Error::Parameter)?;
+        if self.ram.is_none() {
+            self.ram = Some(PortLock::new(SMFI_RAM_BASE, SMFI_RAM_BASE + SMFI_RAM_SIZE as u16 - 1)?);
+        }
+        let ram = self.ram.as_mut().ok_or(Error::Parameter)?;
+        Ok(ram.read_at(offset, data)?)
+    }
 }
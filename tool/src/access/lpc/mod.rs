@@ -7,6 +7,11 @@ const SMFI_DBG_BASE: u16 = 0xF00;
 #[cfg(all(feature = "std", target_os = "linux"))]
 const SMFI_DBG_SIZE: usize = 0x100;
 
+#[cfg(feature = "std")]
+const SMFI_RAM_BASE: u16 = 0x800;
+#[cfg(feature = "std")]
+const SMFI_RAM_SIZE: usize = 0x600;
+
 const SMFI_CMD_CMD: u8 = 0x00;
 const SMFI_CMD_RES: u8 = 0x01;
 const SMFI_CMD_DATA: u8 = 0x02;
@@ -85,16 +85,24 @@ impl AccessLpcSim {
 
 impl Access for AccessLpcSim {
     unsafe fn command(&mut self, cmd: u8, data: &mut [u8]) -> Result<u8, Error> {
+        let len = data.len();
+        self.command_len(cmd, data, len, len)
+    }
+
+    unsafe fn command_len(&mut self, cmd: u8, data: &mut [u8], request: usize, response: usize) -> Result<u8, Error> {
         // Test data length
         if data.len() > self.data_size() {
             return Err(Error::DataLength(data.len()));
         }
+        if request > data.len() || response > data.len() {
+            return Err(Error::Parameter);
+        }
 
         // All previous commands should be finished
         self.command_check()?;
 
-        // Write data bytes, index should be valid due to length test above
-        for i in 0..data.len() {
+        // Write request bytes, index should be valid due to length test above
+        for i in 0..request {
             self.write_cmd(i as u8 + SMFI_CMD_DATA, data[i])?;
         }
 
@@ -105,8 +113,8 @@ impl Access for AccessLpcSim {
         self.timeout.reset();
         timeout!(self.timeout, self.command_check())?;
 
-        // Read data bytes, index should be valid due to length test above
-        for i in 0..data.len() {
+        // Read response bytes, index should be valid due to length test above
+        for i in 0..response {
             data[i] = self.read_cmd(i as u8 + SMFI_CMD_DATA)?;
         }
 
@@ -121,4 +129,14 @@ impl Access for AccessLpcSim {
     unsafe fn read_debug(&mut self, addr: u8) -> Result<u8, Error> {
         self.inb(SMFI_DBG_BASE + u16::from(addr))
     }
+
+    unsafe fn read_ram(&mut self, addr: u16, data: &mut [u8]) -> Result<(), Error> {
+        if addr < SMFI_RAM_BASE || (addr - SMFI_RAM_BASE) as usize + data.len() > SMFI_RAM_SIZE {
+            return Err(Error::Parameter);
+        }
+        for i in 0..data.len() {
+            data[i] = self.inb(addr + i as u16)?;
+        }
+        Ok(())
+    }
 }
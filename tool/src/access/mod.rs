@@ -27,6 +27,15 @@ pub trait Access: Downcast + Send + 'static {
     /// Sends a command using the access method. Only internal use is recommended
     unsafe fn command(&mut self, cmd: u8, data: &mut [u8]) -> Result<u8, Error>;
 
+    /// Sends a command, only writing the first `request` bytes of data and reading back the
+    /// first `response` bytes. Access methods that can skip unused bytes should override this
+    unsafe fn command_len(&mut self, cmd: u8, data: &mut [u8], request: usize, response: usize) -> Result<u8, Error> {
+        if request > data.len() || response > data.len() {
+            return Err(Error::Parameter);
+        }
+        self.command(cmd, data)
+    }
+
     /// The maximum size that can be provided for the data argument
     fn data_size(&self) -> usize;
 
@@ -35,6 +44,23 @@ pub trait Access: Downcast + Send + 'static {
     unsafe fn read_debug(&mut self, _addr: u8) -> Result<u8, Error> {
         Err(Error::NotSupported)
     }
+
+    /// Read from the host RAM windows after the command and debug space, at
+    /// addresses 0x800 to 0xDFF. Only valid if the EC reports the region is mapped
+    unsafe fn read_ram(&mut self, _addr: u16, _data: &mut [u8]) -> Result<(), Error> {
+        Err(Error::NotSupported)
+    }
+
+    /// Read a contiguous range from the debug space
+    unsafe fn read_debug_range(&mut self, addr: u8, data: &mut [u8]) -> Result<(), Error> {
+        if addr as usize + data.len() > 256 {
+            return Err(Error::Parameter);
+        }
+        for i in 0..data.len() {
+            data[i] = self.read_debug(addr + i as u8)?;
+        }
+        Ok(())
+    }
 }
 
 impl Access for Box<dyn Access> {
@@ -42,6 +68,10 @@ impl Access for Box<dyn Access> {
         (**self).command(cmd, data)
     }
 
+    unsafe fn command_len(&mut self, cmd: u8, data: &mut [u8], request: usize, response: usize) -> Result<u8, Error> {
+        (**self).command_len(cmd, data, request, response)
+    }
+
     fn data_size(&self) -> usize {
         (**self).data_size()
     }
@@ -49,6 +79,14 @@ impl Access for Box<dyn Access> {
     unsafe fn read_debug(&mut self, addr: u8) -> Result<u8, Error> {
         (**self).read_debug(addr)
     }
+
+    unsafe fn read_debug_range(&mut self, addr: u8, data: &mut [u8]) -> Result<(), Error> {
+        (**self).read_debug_range(addr, data)
+    }
+
+    unsafe fn read_ram(&mut self, addr: u16, data: &mut [u8]) -> Result<(), Error> {
+        (**self).read_ram(addr, data)
+    }
 }
 
 downcast_rs::impl_downcast!(Access);
@@ -4,8 +4,11 @@
 use alloc::{
     boxed::Box,
     vec,
+    vec::Vec,
 };
 
+use core::cmp;
+
 use crate::{
     Access,
     Error,
@@ -36,6 +39,11 @@ enum Cmd {
     MatrixGet = 17,
     LedSave = 18,
     SetNoInput = 19,
+    SpiCrc32 = 20,
+    SpiProgram = 21,
+    ProfileGet = 22,
+    PowerTrace = 23,
+    BootGet = 24,
 }
 
 const CMD_SPI_FLAG_READ: u8 = 1 << 0;
@@ -43,10 +51,105 @@ const CMD_SPI_FLAG_DISABLE: u8 = 1 << 1;
 const CMD_SPI_FLAG_SCRATCH: u8 = 1 << 2;
 const CMD_SPI_FLAG_BACKUP: u8 = 1 << 3;
 
+const CMD_PROFILE_FLAG_RESET: u8 = 1 << 0;
+
+const CMD_POWER_TRACE_FLAG_CLEAR: u8 = 1 << 0;
+const CMD_POWER_TRACE_ENTRIES: usize = 8;
+
+const CMD_BOOT_POST_ENTRIES: usize = 8;
+
+const CMD_PROBE_FLAG_DEBUG_WRAP: u8 = 1 << 0;
+const CMD_PROBE_FLAG_DEBUG_LOG: u8 = 1 << 1;
+const CMD_PROBE_FLAG_TELEMETRY: u8 = 1 << 2;
+
+const TELEMETRY_BASE: u16 = 0xC00;
+const TELEMETRY_VERSION: u8 = 1;
+const TELEMETRY_SIZE: usize = 0x1E;
+
+/// Snapshot of sensor values, read from the telemetry region
+#[derive(Clone, Copy, Debug, Default)]
+pub struct Telemetry {
+    /// Power state
+    pub power_state: u8,
+    /// CPU temperature in degrees Celsius
+    pub cpu_temp: i16,
+    /// dGPU temperature in degrees Celsius, 0 if there is no dGPU
+    pub dgpu_temp: i16,
+    /// Fan duty cycles, out of 255
+    pub fan_duty: [u8; 2],
+    /// Fan tachometer readings
+    pub fan_tach: [u16; 2],
+    /// Battery temperature in 0.1 K
+    pub battery_temp: u16,
+    /// Battery voltage in mV
+    pub battery_voltage: u16,
+    /// Battery current in mA
+    pub battery_current: i16,
+    /// Battery relative state of charge in percent
+    pub battery_charge: u16,
+    /// Battery remaining capacity in mAh
+    pub battery_remaining_capacity: u16,
+    /// Battery full charge capacity in mAh
+    pub battery_full_capacity: u16,
+    /// Battery status register
+    pub battery_status: u16,
+    /// Battery cycle count
+    pub battery_cycle_count: u16,
+}
+
+/// Duration statistics of a main loop task, in EC timer ticks of 12 / 9.2 MHz
+#[derive(Clone, Copy, Debug, Default)]
+pub struct ProfileStats {
+    /// Number of tasks reported by the EC
+    pub tasks: u8,
+    /// Shortest run
+    pub min: u32,
+    /// Longest run
+    pub max: u32,
+    /// Sum of all runs
+    pub total: u32,
+    /// Number of runs
+    pub count: u32,
+}
+
+/// Power sequencing signal change, read from the power trace
+#[derive(Clone, Copy, Debug)]
+pub struct PowerTrace {
+    /// EC time in microseconds, which wraps after about 71 minutes
+    pub time: u32,
+    /// Signal ID, see `enum PowerTraceId` in the firmware
+    pub id: u8,
+    /// New signal value, or power state if `id` is 0
+    pub value: u8,
+}
+
+/// POST code, with the EC time in ms when it was read
+#[derive(Clone, Copy, Debug)]
+pub struct PostCode {
+    pub time: u32,
+    pub code: u16,
+}
+
+/// Boot timing marks in EC time in ms, if they happened since the last power button press
+#[derive(Clone, Debug, Default)]
+pub struct BootTimes {
+    /// Power button press confirmed
+    pub power_button: Option<u32>,
+    /// PLT_RST# de-asserted
+    pub plt_rst: Option<u32>,
+    /// ACPI OS driver loaded
+    pub acpi_os: Option<u32>,
+    /// First POST code
+    pub first_post: Option<PostCode>,
+    /// Most recent POST codes, oldest first
+    pub posts: Vec<PostCode>,
+}
+
 /// Run EC commands using a provided access method
 pub struct Ec<A: Access> {
     access: A,
     version: u8,
+    flags: u8,
 }
 
 impl<A: Access> Ec<A> {
@@ -56,6 +159,7 @@ impl<A: Access> Ec<A> {
         let mut ec = Ec {
             access,
             version: 0,
+            flags: 0,
         };
 
         // Read version of protocol
@@ -70,13 +174,29 @@ impl<A: Access> Ec<A> {
         Ok(ec)
     }
 
+    /// Returns true if the debug region has a wrap counter, from the last probe
+    pub fn debug_wrap(&self) -> bool {
+        self.flags & CMD_PROBE_FLAG_DEBUG_WRAP != 0
+    }
+
+    /// Returns true if the larger log ring is mapped in host RAM, from the last probe
+    pub fn debug_log(&self) -> bool {
+        self.flags & CMD_PROBE_FLAG_DEBUG_LOG != 0
+    }
+
+    /// Returns true if the telemetry region is mapped in host RAM, from the last probe
+    pub fn telemetry_available(&self) -> bool {
+        self.flags & CMD_PROBE_FLAG_TELEMETRY != 0
+    }
+
     /// Unsafe access to access
     pub unsafe fn access(&mut self) -> &mut A {
         &mut self.access
     }
 
-    unsafe fn command(&mut self, cmd: Cmd, data: &mut [u8]) -> Result<(), Error> {
-        match self.access.command(cmd as u8, data)? {
+    /// Run a command, writing `request` bytes of data and reading back `response` bytes
+    unsafe fn command(&mut self, cmd: Cmd, data: &mut [u8], request: usize, response: usize) -> Result<(), Error> {
+        match self.access.command_len(cmd as u8, data, request, response)? {
             0 => Ok(()),
             err => Err(Error::Protocol(err)),
         }
@@ -84,11 +204,13 @@ impl<A: Access> Ec<A> {
 
     /// Probe for EC
     pub unsafe fn probe(&mut self) -> Result<u8, Error> {
-        let mut data = [0; 3];
-        self.command(Cmd::Probe, &mut data)?;
+        // Older firmware leaves the capability flags as written
+        let mut data = [0; 4];
+        self.command(Cmd::Probe, &mut data, 4, 4)?;
         let signature = (data[0], data[1]);
         if signature == (0x76, 0xEC) {
             let version = data[2];
+            self.flags = data[3];
             Ok(version)
         } else {
             Err(Error::Signature(signature))
@@ -97,7 +219,8 @@ impl<A: Access> Ec<A> {
 
     /// Read board from EC
     pub unsafe fn board(&mut self, data: &mut [u8]) -> Result<usize, Error> {
-        self.command(Cmd::Board, data)?;
+        let len = data.len();
+        self.command(Cmd::Board, data, 0, len)?;
         let mut i = 0;
         while i < data.len() {
             if data[i] == 0 {
@@ -110,7 +233,8 @@ impl<A: Access> Ec<A> {
 
     /// Read version from EC
     pub unsafe fn version(&mut self, data: &mut [u8]) -> Result<usize, Error> {
-        self.command(Cmd::Version, data)?;
+        let len = data.len();
+        self.command(Cmd::Version, data, 0, len)?;
         let mut i = 0;
         while i < data.len() {
             if data[i] == 0 {
@@ -123,15 +247,15 @@ impl<A: Access> Ec<A> {
 
     /// Print data to EC console
     pub unsafe fn print(&mut self, data: &[u8]) -> Result<usize, Error> {
-        //TODO: use self.access.data_size()
         let flags = 0;
-        for chunk in data.chunks(256 - 4) {
-            let mut data = [0; 256 - 2];
-            data[0] = flags;
-            data[1] = chunk.len() as u8;
-            data[2..chunk.len()].clone_from_slice(chunk);
-            self.command(Cmd::Print, &mut data)?;
-            if data[1] != chunk.len() as u8 {
+        let mut buffer = vec![0; self.access.data_size()];
+        for chunk in data.chunks(buffer.len() - 2) {
+            let frame = &mut buffer[..(chunk.len() + 2)];
+            frame[0] = flags;
+            frame[1] = chunk.len() as u8;
+            frame[2..].clone_from_slice(chunk);
+            self.command(Cmd::Print, frame, chunk.len() + 2, 2)?;
+            if frame[1] != chunk.len() as u8 {
                 return Err(Error::Verify);
             }
         }
@@ -153,7 +277,7 @@ impl<A: Access> Ec<A> {
 
     /// Reset EC. Will also power off computer.
     pub unsafe fn reset(&mut self) -> Result<(), Error> {
-        self.command(Cmd::Reset, &mut [])
+        self.command(Cmd::Reset, &mut [], 0, 0)
     }
 
     /// Read fan duty cycle by fan index
@@ -162,7 +286,7 @@ impl<A: Access> Ec<A> {
             index,
             0
         ];
-        self.command(Cmd::FanGet, &mut data)?;
+        self.command(Cmd::FanGet, &mut data, 1, 2)?;
         Ok(data[1])
     }
 
@@ -172,7 +296,150 @@ impl<A: Access> Ec<A> {
             index,
             duty
         ];
-        self.command(Cmd::FanSet, &mut data)
+        self.command(Cmd::FanSet, &mut data, 2, 0)
+    }
+
+    /// Read duration statistics of a main loop task, only supported by firmware built with
+    /// PROFILE=1. If `reset` is set, all statistics are cleared after reading
+    pub unsafe fn profile_get(&mut self, index: u8, reset: bool) -> Result<ProfileStats, Error> {
+        let mut data = [0; 18];
+        data[0] = index;
+        data[1] = if reset { CMD_PROFILE_FLAG_RESET } else { 0 };
+        self.command(Cmd::ProfileGet, &mut data, 2, 18)?;
+        let u32_at = |i: usize| {
+            data[i] as u32 |
+            (data[i + 1] as u32) << 8 |
+            (data[i + 2] as u32) << 16 |
+            (data[i + 3] as u32) << 24
+        };
+        Ok(ProfileStats {
+            tasks: data[1],
+            min: u32_at(2),
+            max: u32_at(6),
+            total: u32_at(10),
+            count: u32_at(14),
+        })
+    }
+
+    /// Read the power sequencing trace, oldest first. If `clear` is set, the trace is cleared
+    /// after reading
+    pub unsafe fn power_trace(&mut self, clear: bool) -> Result<Vec<PowerTrace>, Error> {
+        let mut traces = Vec::new();
+        let mut data = [0; 3 + CMD_POWER_TRACE_ENTRIES * 6];
+        loop {
+            let len = data.len();
+            data[0] = traces.len() as u8;
+            data[1] = 0;
+            self.command(Cmd::PowerTrace, &mut data, 2, len)?;
+            let count = data[1] as usize;
+            let entries = cmp::min(data[2] as usize, CMD_POWER_TRACE_ENTRIES);
+            for entry in data[3..].chunks(6).take(entries) {
+                traces.push(PowerTrace {
+                    time: u32::from_le_bytes([entry[0], entry[1], entry[2], entry[3]]),
+                    id: entry[4],
+                    value: entry[5],
+                });
+            }
+            if entries == 0 || traces.len() >= count {
+                break;
+            }
+        }
+
+        if clear {
+            data[0] = traces.len() as u8;
+            data[1] = CMD_POWER_TRACE_FLAG_CLEAR;
+            self.command(Cmd::PowerTrace, &mut data, 2, 3)?;
+        }
+
+        Ok(traces)
+    }
+
+    /// Read boot timing marks and POST codes
+    pub unsafe fn boot_times(&mut self) -> Result<BootTimes, Error> {
+        let mut times = BootTimes::default();
+        let mut data = [0; 22 + CMD_BOOT_POST_ENTRIES * 6];
+        loop {
+            let len = data.len();
+            data[0] = times.posts.len() as u8;
+            self.command(Cmd::BootGet, &mut data, 1, len)?;
+
+            let valid = data[1];
+            let u32_at = |i: usize| u32::from_le_bytes([data[i], data[i + 1], data[i + 2], data[i + 3]]);
+            let mark = |bit: u8, i: usize| if valid & (1 << bit) != 0 { Some(u32_at(i)) } else { None };
+            times.power_button = mark(0, 2);
+            times.plt_rst = mark(1, 6);
+            times.acpi_os = mark(2, 10);
+            times.first_post = mark(3, 14).map(|time| PostCode {
+                time,
+                code: u16::from_le_bytes([data[18], data[19]]),
+            });
+
+            let count = data[20] as usize;
+            let entries = cmp::min(data[21] as usize, CMD_BOOT_POST_ENTRIES);
+            for entry in data[22..].chunks(6).take(entries) {
+                times.posts.push(PostCode {
+                    time: u32::from_le_bytes([entry[0], entry[1], entry[2], entry[3]]),
+                    code: u16::from_le_bytes([entry[4], entry[5]]),
+                });
+            }
+            if entries == 0 || times.posts.len() >= count {
+                break;
+            }
+        }
+        Ok(times)
+    }
+
+    /// Read a consistent snapshot of the telemetry region, without sending a command
+    pub unsafe fn telemetry(&mut self) -> Result<Telemetry, Error> {
+        if !self.telemetry_available() {
+            return Err(Error::NotSupported);
+        }
+
+        let mut data = [0; TELEMETRY_SIZE];
+        let mut tries = 0;
+        loop {
+            // Sequence number is odd while the EC is updating. The snapshot is only consistent if
+            // the sequence number is even and unchanged after the whole region has been read
+            let mut sequence = [0];
+            self.access.read_ram(TELEMETRY_BASE, &mut sequence)?;
+            if sequence[0] & 1 == 0 {
+                self.access.read_ram(TELEMETRY_BASE, &mut data)?;
+                let mut after = [0];
+                self.access.read_ram(TELEMETRY_BASE, &mut after)?;
+                if after[0] == sequence[0] {
+                    break;
+                }
+            }
+
+            tries += 1;
+            if tries >= 16 {
+                return Err(Error::Timeout);
+            }
+        }
+
+        if data[1] != TELEMETRY_VERSION {
+            return Err(Error::Version(data[1]));
+        }
+        if (data[2] as usize) < TELEMETRY_SIZE {
+            return Err(Error::Verify);
+        }
+
+        let u16_at = |i: usize| data[i] as u16 | (data[i + 1] as u16) << 8;
+        Ok(Telemetry {
+            power_state: data[3],
+            cpu_temp: u16_at(4) as i16,
+            dgpu_temp: u16_at(6) as i16,
+            fan_duty: [data[8], data[9]],
+            fan_tach: [u16_at(10), u16_at(12)],
+            battery_temp: u16_at(14),
+            battery_voltage: u16_at(16),
+            battery_current: u16_at(18) as i16,
+            battery_charge: u16_at(20),
+            battery_remaining_capacity: u16_at(22),
+            battery_full_capacity: u16_at(24),
+            battery_status: u16_at(26),
+            battery_cycle_count: u16_at(28),
+        })
     }
 
     /// Read keymap data by layout, output pin, and input pin
@@ -184,7 +451,7 @@ impl<A: Access> Ec<A> {
             0,
             0
         ];
-        self.command(Cmd::KeymapGet, &mut data)?;
+        self.command(Cmd::KeymapGet, &mut data, 3, 5)?;
         Ok(
             (data[3] as u16) |
             ((data[4] as u16) << 8)
@@ -200,7 +467,7 @@ impl<A: Access> Ec<A> {
             value as u8,
             (value >> 8) as u8
         ];
-        self.command(Cmd::KeymapSet, &mut data)
+        self.command(Cmd::KeymapSet, &mut data, 5, 0)
     }
 
     // Get LED value by index
@@ -210,7 +477,7 @@ impl<A: Access> Ec<A> {
             0,
             0,
         ];
-        self.command(Cmd::LedGetValue, &mut data)?;
+        self.command(Cmd::LedGetValue, &mut data, 1, 3)?;
         Ok((data[1], data[2]))
     }
 
@@ -220,7 +487,7 @@ impl<A: Access> Ec<A> {
             index,
             value,
         ];
-        self.command(Cmd::LedSetValue, &mut data)
+        self.command(Cmd::LedSetValue, &mut data, 2, 0)
     }
 
     // Get LED color by index
@@ -231,7 +498,7 @@ impl<A: Access> Ec<A> {
             0,
             0,
         ];
-        self.command(Cmd::LedGetColor, &mut data)?;
+        self.command(Cmd::LedGetColor, &mut data, 1, 4)?;
         Ok((
             data[1],
             data[2],
@@ -247,7 +514,7 @@ impl<A: Access> Ec<A> {
             green,
             blue,
         ];
-        self.command(Cmd::LedSetColor, &mut data)
+        self.command(Cmd::LedSetColor, &mut data, 4, 0)
     }
 
     pub unsafe fn led_get_mode(&mut self, layer: u8) -> Result<(u8, u8), Error> {
@@ -256,7 +523,7 @@ impl<A: Access> Ec<A> {
             0,
             0,
         ];
-        self.command(Cmd::LedGetMode, &mut data)?;
+        self.command(Cmd::LedGetMode, &mut data, 1, 3)?;
         Ok((
             data[1],
             data[2]
@@ -269,19 +536,20 @@ impl<A: Access> Ec<A> {
             mode,
             speed,
         ];
-        self.command(Cmd::LedSetMode, &mut data)
+        self.command(Cmd::LedSetMode, &mut data, 3, 0)
     }
 
     pub unsafe fn led_save(&mut self) -> Result<(), Error> {
-        self.command(Cmd::LedSave, &mut [])
+        self.command(Cmd::LedSave, &mut [], 0, 0)
     }
 
     pub unsafe fn matrix_get(&mut self, matrix: &mut [u8]) -> Result<(), Error> {
-        self.command(Cmd::MatrixGet, matrix)
+        let len = matrix.len();
+        self.command(Cmd::MatrixGet, matrix, 0, len)
     }
 
     pub unsafe fn set_no_input(&mut self, no_input: bool) -> Result<(), Error> {
-        self.command(Cmd::SetNoInput, &mut [no_input as u8])
+        self.command(Cmd::SetNoInput, &mut [no_input as u8], 1, 0)
     }
 
     pub fn into_dyn(self) -> Ec<Box<dyn Access>>
@@ -289,7 +557,7 @@ impl<A: Access> Ec<A> {
         Ec {
             access: Box::new(self.access),
             version: self.version,
-
+            flags: self.flags,
         }
     }
 }
@@ -338,7 +606,7 @@ impl<'a, A: Access> Spi for EcSpi<'a, A> {
         let flags = self.flags(false, true);
         self.buffer[0] = flags;
         self.buffer[1] = 0;
-        self.ec.command(Cmd::Spi, &mut self.buffer[..2])?;
+        self.ec.command(Cmd::Spi, &mut self.buffer[..2], 2, 2)?;
         if self.buffer[1] != 0 {
             return Err(Error::Verify);
         }
@@ -351,7 +619,7 @@ impl<'a, A: Access> Spi for EcSpi<'a, A> {
         for chunk in data.chunks_mut(self.buffer.len() - 2) {
             self.buffer[0] = flags;
             self.buffer[1] = chunk.len() as u8;
-            self.ec.command(Cmd::Spi, &mut self.buffer[..(chunk.len() + 2)])?;
+            self.ec.command(Cmd::Spi, &mut self.buffer[..(chunk.len() + 2)], 2, chunk.len() + 2)?;
             if self.buffer[1] != chunk.len() as u8 {
                 return Err(Error::Verify);
             }
@@ -371,13 +639,104 @@ impl<'a, A: Access> Spi for EcSpi<'a, A> {
             for i in 0..chunk.len() {
                 self.buffer[i + 2] = chunk[i];
             }
-            self.ec.command(Cmd::Spi, &mut self.buffer[..(chunk.len() + 2)])?;
+            self.ec.command(Cmd::Spi, &mut self.buffer[..(chunk.len() + 2)], chunk.len() + 2, 2)?;
             if self.buffer[1] != chunk.len() as u8 {
                 return Err(Error::Verify);
             }
         }
         Ok(data.len())
     }
+
+    /// SPI CRC32, calculated by the EC without transferring data
+    unsafe fn crc32(&mut self, address: u32, length: u32) -> Result<u32, Error> {
+        if (address & 0xFF00_0000) > 0 || (length & 0xFF00_0000) > 0 {
+            return Err(Error::Parameter);
+        }
+
+        self.reset()?;
+
+        let mut data = [
+            self.flags(false, true),
+            address as u8,
+            (address >> 8) as u8,
+            (address >> 16) as u8,
+            length as u8,
+            (length >> 8) as u8,
+            (length >> 16) as u8,
+            0,
+            0,
+            0,
+            0,
+        ];
+        match self.ec.command(Cmd::SpiCrc32, &mut data, 7, 11) {
+            Ok(()) => (),
+            // Only the scratch ROM implements this command
+            Err(Error::Protocol(_)) => return Err(Error::NotSupported),
+            Err(err) => return Err(err),
+        }
+
+        Ok(
+            (data[7] as u32) |
+            (data[8] as u32) << 8 |
+            (data[9] as u32) << 16 |
+            (data[10] as u32) << 24
+        )
+    }
+
+    /// SPI program, with write enable and busy polling done by the EC
+    unsafe fn program(&mut self, address: u32, data: &[u8]) -> Result<usize, Error> {
+        // Each chunk is flags, length, 24-bit address, and data
+        let limit = self.buffer.len() - 5;
+        let max_chunk = match self.target {
+            // AAI programs words, so only the last chunk may be odd. Each chunk sends its own
+            // address, so chunks only need to start on a word
+            SpiTarget::Main => cmp::min(limit, 248) & !1,
+            // Page program must not cross a 256 byte page
+            SpiTarget::Backup => cmp::min(limit, 256),
+        };
+
+        // Validate everything before anything is sent, so a rejected range leaves the ROM as is
+        let end = address as usize + data.len();
+        if max_chunk == 0 || end > 0x0100_0000 {
+            return Err(Error::Parameter);
+        }
+        if let SpiTarget::Main = self.target {
+            if address % 2 != 0 {
+                return Err(Error::Parameter);
+            }
+        }
+
+        self.reset()?;
+
+        let flags = self.flags(false, true);
+        let mut chunk_address = address as usize;
+        while chunk_address < end {
+            let mut chunk_size = cmp::min(max_chunk, end - chunk_address);
+            if let SpiTarget::Backup = self.target {
+                chunk_size = cmp::min(chunk_size, 256 - (chunk_address % 256));
+            }
+            let offset = chunk_address - address as usize;
+            let chunk = &data[offset..(offset + chunk_size)];
+
+            self.buffer[0] = flags;
+            self.buffer[1] = chunk.len() as u8;
+            self.buffer[2] = chunk_address as u8;
+            self.buffer[3] = (chunk_address >> 8) as u8;
+            self.buffer[4] = (chunk_address >> 16) as u8;
+            for j in 0..chunk.len() {
+                self.buffer[j + 5] = chunk[j];
+            }
+            match self.ec.command(Cmd::SpiProgram, &mut self.buffer[..(chunk.len() + 5)], chunk.len() + 5, 0) {
+                Ok(()) => (),
+                // Only the scratch ROM implements this command
+                Err(Error::Protocol(_)) if offset == 0 => return Err(Error::NotSupported),
+                Err(err) => return Err(err),
+            }
+
+            chunk_address += chunk_size;
+        }
+        Ok(data.len())
+    }
 }
 
 impl<'a, A: Access> Drop for EcSpi<'a, A> {
@@ -387,3 +746,111 @@ impl<'a, A: Access> Drop for EcSpi<'a, A> {
         }
     }
 }
+
+#[cfg(all(test, feature = "std"))]
+mod tests {
+    use super::*;
+    use crate::{SpiRom, StdTimeout};
+    use std::time::Duration;
+
+    /// Scratch ROM that programs an in-memory SPI ROM
+    struct ScratchRom {
+        data_size: usize,
+        rom: Vec<u8>,
+        programs: usize,
+    }
+
+    impl Access for ScratchRom {
+        unsafe fn command(&mut self, cmd: u8, data: &mut [u8]) -> Result<u8, Error> {
+            let len = data.len();
+            self.command_len(cmd, data, len, len)
+        }
+
+        unsafe fn command_len(&mut self, cmd: u8, data: &mut [u8], _request: usize, _response: usize) -> Result<u8, Error> {
+            if cmd == Cmd::Probe as u8 {
+                data[..4].copy_from_slice(&[0x76, 0xEC, 1, 0]);
+            } else if cmd == Cmd::Spi as u8 {
+                // Plain SPI transfers are only used for write disable, reads see an idle status
+                if data[0] & CMD_SPI_FLAG_READ != 0 {
+                    for b in data[2..].iter_mut() {
+                        *b = 0;
+                    }
+                }
+            } else if cmd == Cmd::SpiProgram as u8 {
+                let len = data[1] as usize;
+                let address = data[2] as usize | (data[3] as usize) << 8 | (data[4] as usize) << 16;
+                if data[0] & CMD_SPI_FLAG_BACKUP != 0 {
+                    assert_eq!(address / 256, (address + len - 1) / 256, "chunk crosses a page");
+                } else {
+                    assert_eq!(address % 2, 0, "chunk is not word aligned");
+                }
+                self.rom[address..(address + len)].copy_from_slice(&data[5..(5 + len)]);
+                self.programs += 1;
+            } else {
+                panic!("unexpected command {}", cmd);
+            }
+            Ok(0)
+        }
+
+        fn data_size(&self) -> usize {
+            self.data_size
+        }
+    }
+
+    unsafe fn flash(data_size: usize, target: SpiTarget, start: usize) -> (Vec<u8>, Vec<u8>) {
+        let mut ec = Ec::new(ScratchRom {
+            data_size,
+            rom: vec![0xFF; 16 * 1024],
+            programs: 0,
+        }).unwrap();
+
+        let new_rom: Vec<u8> = (0..ec.access().rom.len()).map(|i| (i * 7 + i / 256) as u8).collect();
+        {
+            let mut spi_bus = ec.spi(target, true).unwrap();
+            let mut spi = SpiRom::new(&mut spi_bus, StdTimeout::new(Duration::new(1, 0)));
+            let sector_size = spi.sector_size();
+            let mut address = start;
+            while address < new_rom.len() {
+                let next_address = address + sector_size;
+                let count = spi.write_at(address as u32, &new_rom[address..next_address]).unwrap();
+                assert_eq!(count, sector_size);
+                address = next_address;
+            }
+        }
+
+        let rom = ec.access().rom.clone();
+        (rom, new_rom)
+    }
+
+    #[test]
+    fn flash_from_second_sector() {
+        for &data_size in &[254, 30] {
+            for &target in &[SpiTarget::Main, SpiTarget::Backup] {
+                let start = match target {
+                    SpiTarget::Main => 1024,
+                    SpiTarget::Backup => 4096,
+                };
+                let (rom, new_rom) = unsafe { flash(data_size, target, start) };
+                assert!(rom[..start].iter().all(|&b| b == 0xFF));
+                assert_eq!(rom[start..], new_rom[start..]);
+            }
+        }
+    }
+
+    #[test]
+    fn program_rejects_before_sending() {
+        unsafe {
+            let mut ec = Ec::new(ScratchRom {
+                data_size: 254,
+                rom: vec![0xFF; 1024],
+                programs: 0,
+            }).unwrap();
+            {
+                let mut spi = ec.spi(SpiTarget::Main, true).unwrap();
+                assert!(matches!(spi.program(1, &[0; 16]), Err(Error::Parameter)));
+                assert!(matches!(spi.program(0x00FF_FFF0, &[0; 32]), Err(Error::Parameter)));
+            }
+            assert_eq!(ec.access().programs, 0);
+        }
+    }
+}
@@ -25,7 +25,7 @@ extern crate alloc;
 pub use self::access::*;
 mod access;
 
-pub use self::ec::Ec;
+pub use self::ec::{BootTimes, Ec, PostCode, PowerTrace, ProfileStats, Telemetry};
 mod ec;
 
 pub use self::error::Error;
@@ -39,12 +39,17 @@ pub use self::legacy::EcLegacy;
 #[cfg(feature = "redox_hwio")]
 mod legacy;
 
+#[cfg(feature = "std")]
+pub use self::log::LogDecoder;
+#[cfg(feature = "std")]
+mod log;
+
 #[cfg(feature = "redox_hwio")]
 pub use self::pmc::Pmc;
 #[cfg(feature = "redox_hwio")]
 mod pmc;
 
-pub use self::spi::{Spi, SpiRom, SpiTarget};
+pub use self::spi::{crc32, Spi, SpiRom, SpiTarget};
 mod spi;
 
 #[cfg(feature = "redox_hwio")]
@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: MIT
+
+use std::collections::HashMap;
+
+use crate::Error;
+
+/// Byte that starts a tokenized log message
+const LOG_MARKER: u8 = 0xFF;
+
+/// Decodes tokenized EC log output, using the dictionary generated by the firmware build
+pub struct LogDecoder {
+    formats: HashMap<(u8, u16), Vec<u8>>,
+    frame: Vec<u8>,
+}
+
+impl LogDecoder {
+    /// Create a decoder from the contents of a dictionary, with one `ID:INDEX<tab>FORMAT`
+    /// entry per line
+    pub fn new(dictionary: &str) -> Result<Self, Error> {
+        let mut formats = HashMap::new();
+        for line in dictionary.lines() {
+            if line.is_empty() {
+                continue;
+            }
+            let mut parts = line.splitn(2, '\t');
+            let token = parts.next().ok_or(Error::Parameter)?;
+            let literal = parts.next().ok_or(Error::Parameter)?;
+            let mut token_parts = token.splitn(2, ':');
+            let file = token_parts.next()
+                .and_then(|x| x.parse::<u8>().ok())
+                .ok_or(Error::Parameter)?;
+            let index = token_parts.next()
+                .and_then(|x| x.parse::<u16>().ok())
+                .ok_or(Error::Parameter)?;
+            formats.insert((file, index), parse_literal(literal)?);
+        }
+        Ok(Self {
+            formats,
+            frame: Vec::new(),
+        })
+    }
+
+    /// Decode `data`, appending text to `output`. Messages may be split across calls
+    pub fn decode(&mut self, data: &[u8], output: &mut Vec<u8>) {
+        for &byte in data {
+            if self.frame.is_empty() {
+                if byte == LOG_MARKER {
+                    self.frame.push(byte);
+                } else {
+                    output.push(byte);
+                }
+                continue;
+            }
+
+            self.frame.push(byte);
+            match parse_frame(&self.frame) {
+                // Message is not complete
+                None => (),
+                Some(Some((token, args))) => {
+                    match self.formats.get(&token) {
+                        Some(format) => format_message(format, &args, output),
+                        None => {
+                            output.extend_from_slice(format!("<log {}:{}", token.0, token.1).as_bytes());
+                            for (value, _) in args.iter() {
+                                output.extend_from_slice(format!(" {:X}", value).as_bytes());
+                            }
+                            output.extend_from_slice(b">\n");
+                        },
+                    }
+                    self.frame.clear();
+                },
+                // Not a valid message, likely lost part of it to an overrun
+                Some(None) => {
+                    output.extend_from_slice(b"<log invalid>\n");
+                    self.frame.clear();
+                },
+            }
+        }
+    }
+}
+
+/// Parse a message frame, returning None if it is incomplete, or Some(None) if it is invalid
+fn parse_frame(frame: &[u8]) -> Option<Option<((u8, u16), Vec<(u32, u8)>)>> {
+    // Marker, file, 16-bit index, and argument count
+    if frame.len() < 5 {
+        return None;
+    }
+    let token = (frame[1], frame[2] as u16 | (frame[3] as u16) << 8);
+    let count = frame[4];
+
+    let mut args = Vec::new();
+    let mut i = 5;
+    for _ in 0..count {
+        let size = *frame.get(i)? as usize;
+        if size == 0 || size > 4 {
+            return Some(None);
+        }
+        if frame.len() < i + 1 + size {
+            return None;
+        }
+        let mut value = 0;
+        for j in 0..size {
+            value |= (frame[i + 1 + j] as u32) << (j * 8);
+        }
+        args.push((value, size as u8));
+        i += 1 + size;
+    }
+    Some(Some((token, args)))
+}
+
+/// Parse one or more adjacent C string literals
+fn parse_literal(literal: &str) -> Result<Vec<u8>, Error> {
+    let mut data = Vec::new();
+    let mut chars = literal.chars().peekable();
+    loop {
+        // Skip whitespace between literals
+        while chars.peek().map_or(false, |c| c.is_whitespace()) {
+            chars.next();
+        }
+        match chars.next() {
+            Some('"') => (),
+            Some(_) => return Err(Error::Parameter),
+            None => return Ok(data),
+        }
+        loop {
+            match chars.next().ok_or(Error::Parameter)? {
+                '"' => break,
+                '\\' => match chars.next().ok_or(Error::Parameter)? {
+                    'n' => data.push(b'\n'),
+                    'r' => data.push(b'\r'),
+                    't' => data.push(b'\t'),
+                    'x' => {
+                        let mut value = 0;
+                        while let Some(digit) = chars.peek().and_then(|c| c.to_digit(16)) {
+                            value = (value << 4) | digit;
+                            chars.next();
+                        }
+                        data.push(value as u8);
+                    },
+                    c @ '0'..='7' => {
+                        let mut value = c.to_digit(8).unwrap();
+                        for _ in 0..2 {
+                            match chars.peek().and_then(|c| c.to_digit(8)) {
+                                Some(digit) => {
+                                    value = (value << 3) | digit;
+                                    chars.next();
+                                },
+                                None => break,
+                            }
+                        }
+                        data.push(value as u8);
+                    },
+                    c => {
+                        let mut buf = [0; 4];
+                        data.extend_from_slice(c.encode_utf8(&mut buf).as_bytes());
+                    },
+                },
+                c => {
+                    let mut buf = [0; 4];
+                    data.extend_from_slice(c.encode_utf8(&mut buf).as_bytes());
+                },
+            }
+        }
+    }
+}
+
+/// Format a message like printf, for the conversions used by the firmware
+fn format_message(format: &[u8], args: &[(u32, u8)], output: &mut Vec<u8>) {
+    let mut args = args.iter();
+    let mut i = 0;
+    while i < format.len() {
+        let byte = format[i];
+        i += 1;
+        if byte != b'%' {
+            output.push(byte);
+            continue;
+        }
+
+        // Flags, width, and length modifiers
+        let mut left = false;
+        let mut zero = false;
+        while i < format.len() && (format[i] == b'-' || format[i] == b'0') {
+            if format[i] == b'-' {
+                left = true;
+            } else {
+                zero = true;
+            }
+            i += 1;
+        }
+        let mut width = 0;
+        while i < format.len() && format[i].is_ascii_digit() {
+            width = width * 10 + (format[i] - b'0') as usize;
+            i += 1;
+        }
+        while i < format.len() && (format[i] == b'l' || format[i] == b'h' || format[i] == b'b') {
+            i += 1;
+        }
+
+        let conversion = match format.get(i) {
+            Some(some) => *some,
+            None => break,
+        };
+        i += 1;
+
+        if conversion == b'%' {
+            output.push(b'%');
+            continue;
+        }
+
+        let (value, size) = match args.next() {
+            Some(some) => *some,
+            None => {
+                output.extend_from_slice(b"<missing>");
+                continue;
+            },
+        };
+        let text = match conversion {
+            b'd' | b'i' => {
+                // Sign extend from the size of the argument
+                let shift = 32 - size as u32 * 8;
+                format!("{}", ((value << shift) as i32) >> shift)
+            },
+            b'u' => format!("{}", value),
+            b'x' => format!("{:x}", value),
+            b'X' => format!("{:X}", value),
+            b'c' => format!("{}", value as u8 as char),
+            // Only the pointer is logged
+            b's' => "<str>".to_string(),
+            _ => format!("<%{}>", conversion as char),
+        };
+
+        let padding = width.saturating_sub(text.len());
+        if left {
+            output.extend_from_slice(text.as_bytes());
+            output.extend(std::iter::repeat(b' ').take(padding));
+        } else {
+            let pad = if zero { b'0' } else { b' ' };
+            output.extend(std::iter::repeat(pad).take(padding));
+            output.extend_from_slice(text.as_bytes());
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn string_literal_argument() {
+        let mut decoder = LogDecoder::new("1:2\t\"%s: %d\\n\"\n").unwrap();
+        let mut output = Vec::new();
+        decoder.decode(&[
+            // Marker, file 1, index 2, and 2 arguments
+            LOG_MARKER, 1, 2, 0, 2,
+            // String literal, only its pointer with the size capped at 32 bits
+            4, 0x34, 0x12, 0x80, 0x00,
+            // 16-bit value
+            2, 0xFE, 0xFF,
+            // Following console output
+            b'o', b'k',
+        ], &mut output);
+        assert_eq!(output, b"<str>: -2\nok");
+    }
+}
@@ -2,6 +2,7 @@
 
 use clap::{Arg, App, AppSettings, SubCommand};
 use ectool::{
+    crc32,
     Access,
     AccessHid,
     AccessLpcLinux,
@@ -9,6 +10,7 @@ use ectool::{
     Ec,
     Error,
     Firmware,
+    LogDecoder,
     StdTimeout,
     Spi,
     SpiRom,
@@ -16,30 +18,147 @@ use ectool::{
 };
 use hidapi::HidApi;
 use std::{
+    cmp,
     fmt::Display,
     fs,
+    io::{self, Write},
     process,
     str::{self, FromStr},
     time::Duration,
     thread,
 };
 
-unsafe fn console(ec: &mut Ec<Box<dyn Access>>) -> Result<(), Error> {
+/// Location and layout of an EC console ring
+struct ConsoleRing {
+    /// Host RAM address of the log region, or None for the debug region
+    log: Option<u16>,
+    /// Size of the tail and wrap count fields
+    field: usize,
+    /// Offset of ring data
+    start: usize,
+    /// Size of ring data
+    size: usize,
+    /// Whether there is a wrap count after the tail
+    wrap: bool,
+}
+
+impl ConsoleRing {
+    unsafe fn read(&self, access: &mut Box<dyn Access>, offset: usize, data: &mut [u8]) -> Result<(), Error> {
+        match self.log {
+            Some(base) => access.read_ram(base + offset as u16, data),
+            None => access.read_debug_range(offset as u8, data),
+        }
+    }
+
+    /// Byte counts are modulo period, laps are only visible with a wrap count
+    fn period(&self) -> usize {
+        if self.wrap {
+            (1 << (self.field * 8)) * self.size
+        } else {
+            self.size
+        }
+    }
+
+    /// Read the count of bytes written, retrying until two reads of the header agree
+    unsafe fn count(&self, access: &mut Box<dyn Access>) -> Result<usize, Error> {
+        let mut header = [0; 4];
+        let len = self.field * 2;
+        self.read(access, 0, &mut header[..len])?;
+        loop {
+            let mut check = [0; 4];
+            self.read(access, 0, &mut check[..len])?;
+            if check == header {
+                break;
+            }
+            header = check;
+        }
+
+        let (tail, wraps) = if self.field == 2 {
+            (
+                header[0] as usize | (header[1] as usize) << 8,
+                header[2] as usize | (header[3] as usize) << 8,
+            )
+        } else {
+            (header[0] as usize, header[1] as usize)
+        };
+        Ok(if tail < self.start {
+            0
+        } else if self.wrap {
+            (wraps * self.size + tail - self.start + 1) % self.period()
+        } else {
+            (tail - self.start + 1) % self.period()
+        })
+    }
+}
+
+unsafe fn console(ec: &mut Ec<Box<dyn Access>>, dictionary: Option<&str>) -> Result<(), Error> {
     //TODO: driver support for reading debug region?
+
+    // Decode tokenized logs if a dictionary from the firmware build is provided
+    let mut decoder = match dictionary {
+        Some(path) => Some(LogDecoder::new(&fs::read_to_string(path)?)?),
+        None => None,
+    };
+    let mut decoded = Vec::new();
+
+    let ring = if ec.debug_log() {
+        // Log region in host RAM, 16-bit tail and wrap count
+        ConsoleRing { log: Some(0x800), field: 2, start: 4, size: 1024 - 4, wrap: true }
+    } else if ec.debug_wrap() {
+        // Debug region, 8-bit tail and wrap count
+        ConsoleRing { log: None, field: 1, start: 2, size: 256 - 2, wrap: true }
+    } else {
+        // Debug region, 8-bit tail only
+        ConsoleRing { log: None, field: 1, start: 1, size: 256 - 1, wrap: false }
+    };
+    let period = ring.period();
+
     let access = ec.access();
+    let stdout = io::stdout();
+    let mut data = vec![0; ring.size];
+    let mut delay = 1;
 
-    let mut head = access.read_debug(0)? as usize;
+    let mut head = ring.count(access)?;
     loop {
-        let tail = access.read_debug(0)? as usize;
-        if tail == 0 || head == tail {
-            thread::sleep(Duration::from_millis(1));
+        let mut available = (ring.count(access)? + period - head) % period;
+        if available > ring.size {
+            eprintln!("\nconsole overrun: {} bytes lost", available - ring.size);
+            head = (head + available - ring.size) % period;
+            available = ring.size;
+        }
+
+        if available > 0 {
+            // New data is at most two contiguous ranges of the ring
+            let index = head % ring.size;
+            let first = cmp::min(available, ring.size - index);
+            ring.read(access, ring.start + index, &mut data[..first])?;
+            ring.read(access, ring.start, &mut data[first..available])?;
+            head = (head + available) % period;
+
+            let output = match decoder {
+                Some(ref mut decoder) => {
+                    decoded.clear();
+                    decoder.decode(&data[..available], &mut decoded);
+                    &decoded[..]
+                },
+                None => &data[..available],
+            };
+
+            let mut stdout = stdout.lock();
+            stdout.write_all(output)?;
+            stdout.flush()?;
+        }
+
+        // Poll faster as the ring fills, and back off while idle
+        if available >= ring.size / 2 {
+            delay = 0;
+        } else if available > 0 {
+            delay = 1;
         } else {
-            while head != tail {
-                head += 1;
-                if head >= 256 { head = 1; }
-                let c = access.read_debug(head as u8)?;
-                print!("{}", c as char);
-            }
+            delay = cmp::min(cmp::max(delay * 2, 1), 8);
+        }
+        if delay > 0 {
+            thread::sleep(Duration::from_millis(delay));
         }
     }
 }
@@ -60,6 +179,63 @@ unsafe fn flash_read<S: Spi>(spi: &mut SpiRom<S, StdTimeout>, rom: &mut [u8], se
     Ok(())
 }
 
+/// Read the ROM, skipping sectors that the EC reports already match `new_rom` by CRC32
+unsafe fn flash_read_diff<S: Spi>(spi: &mut SpiRom<S, StdTimeout>, rom: &mut [u8], new_rom: &[u8], sector_size: usize) -> Result<(), Error> {
+    let mut address = 0;
+    while address < rom.len() {
+        eprint!("\rSPI Compare {}K", address / 1024);
+        let next_address = address + sector_size;
+        match spi.crc32_at(address as u32, sector_size as u32) {
+            Ok(crc) => if crc == crc32(&new_rom[address..next_address]) {
+                rom[address..next_address].copy_from_slice(&new_rom[address..next_address]);
+            } else {
+                let count = spi.read_at(address as u32, &mut rom[address..next_address])?;
+                if count != sector_size {
+                    eprintln!("\ncount {} did not match sector size {}", count, sector_size);
+                    return Err(Error::Verify);
+                }
+            },
+            Err(Error::NotSupported) => {
+                eprintln!("\rSPI CRC32 not supported, reading entire ROM");
+                return flash_read(spi, rom, sector_size);
+            },
+            Err(err) => return Err(err),
+        }
+        address = next_address;
+    }
+    eprintln!("\rSPI Compare {}K", address / 1024);
+    Ok(())
+}
+
+/// Verify the ROM matches `new_rom`, using CRC32 of each sector when supported
+unsafe fn flash_verify<S: Spi>(spi: &mut SpiRom<S, StdTimeout>, rom: &mut [u8], new_rom: &[u8], sector_size: usize) -> Result<(), Error> {
+    let mut address = 0;
+    while address < rom.len() {
+        eprint!("\rSPI Verify {}K", address / 1024);
+        let next_address = address + sector_size;
+        match spi.crc32_at(address as u32, sector_size as u32) {
+            Ok(crc) => if crc != crc32(&new_rom[address..next_address]) {
+                eprintln!("\nFailed to program: sector {:X} has CRC32 {:08X}", address, crc);
+                return Err(Error::Verify);
+            },
+            Err(Error::NotSupported) => {
+                flash_read(spi, rom, sector_size)?;
+                for i in 0..rom.len() {
+                    if rom[i] != new_rom[i] {
+                        eprintln!("Failed to program: {:X} is {:X} instead of {:X}", i, rom[i], new_rom[i]);
+                        return Err(Error::Verify);
+                    }
+                }
+                return Ok(());
+            },
+            Err(err) => return Err(err),
+        }
+        address = next_address;
+    }
+    eprintln!("\rSPI Verify {}K", address / 1024);
+    Ok(())
+}
+
 unsafe fn flash_inner(ec: &mut Ec<Box<dyn Access>>, firmware: &Firmware, target: SpiTarget, scratch: bool) -> Result<(), Error> {
     let rom_size = 128 * 1024;
 
@@ -75,8 +251,14 @@ unsafe fn flash_inner(ec: &mut Ec<Box<dyn Access>>, firmware: &Firmware, target:
     );
     let sector_size = spi.sector_size();
 
+    // Check the image fits in whole sectors before anything is erased
+    if new_rom.len() != rom_size || rom_size % sector_size != 0 {
+        eprintln!("Image size {} does not fit ROM size {}", new_rom.len(), rom_size);
+        return Err(Error::Parameter);
+    }
+
     let mut rom = vec![0xFF; rom_size];
-    flash_read(&mut spi, &mut rom, sector_size)?;
+    flash_read_diff(&mut spi, &mut rom, &new_rom, sector_size)?;
 
     eprintln!("Saving ROM to backup.rom");
     fs::write("backup.rom", &rom).map_err(|_| Error::Verify)?;
@@ -123,13 +305,7 @@ unsafe fn flash_inner(ec: &mut Ec<Box<dyn Access>>, firmware: &Firmware, target:
         eprintln!("\rSPI Write {}K", address / 1024);
 
         // Verify chip write
-        flash_read(&mut spi, &mut rom, sector_size)?;
-        for i in 0..rom.len() {
-            if rom[i] != new_rom[i] {
-                eprintln!("Failed to program: {:X} is {:X} instead of {:X}", i, rom[i], new_rom[i]);
-                return Err(Error::Verify);
-            }
-        }
+        flash_verify(&mut spi, &mut rom, &new_rom, sector_size)?;
     }
 
     eprintln!("Successfully programmed SPI ROM");
@@ -266,6 +442,141 @@ unsafe fn fan_set(ec: &mut Ec<Box<dyn Access>>, index: u8, duty: u8) -> Result<(
     ec.fan_set(index, duty)
 }
 
+unsafe fn profile(ec: &mut Ec<Box<dyn Access>>, reset: bool) -> Result<(), Error> {
+    // Must match enum ProfileTask in the firmware
+    let names = [
+        "power", "kbscan", "lid", "fan", "battery", "board", "kbc", "pmc", "smfi", "stdio",
+    ];
+    // EC timer 0 ticks at 9.2 MHz / 12
+    let us = |ticks: u32| ticks as u64 * 30 / 23;
+
+    println!("{:<10} {:>10} {:>10} {:>10} {:>10} {:>12}", "task", "count", "min us", "avg us", "max us", "total us");
+    let mut index = 0;
+    loop {
+        let stats = ec.profile_get(index, false)?;
+        let name = names.get(index as usize).map_or(format!("{}", index), |x| x.to_string());
+        let avg = if stats.count > 0 { stats.total / stats.count } else { 0 };
+        println!(
+            "{:<10} {:>10} {:>10} {:>10} {:>10} {:>12}",
+            name, stats.count, us(stats.min), us(avg), us(stats.max), us(stats.total)
+        );
+
+        index += 1;
+        if index >= stats.tasks {
+            break;
+        }
+    }
+
+    // Clear all tasks once they have been read
+    if reset {
+        ec.profile_get(0, true)?;
+    }
+
+    Ok(())
+}
+
+unsafe fn boot(ec: &mut Ec<Box<dyn Access>>) -> Result<(), Error> {
+    let times = ec.boot_times()?;
+    let start = match times.power_button {
+        Some(some) => some,
+        None => {
+            println!("no power button press recorded");
+            return Ok(());
+        }
+    };
+    // EC time wraps, so use wrapping differences
+    let since = |time: u32| time.wrapping_sub(start) as f64 / 1000.0;
+
+    println!("{:<28} {:>10}", "event", "time s");
+    println!("{:<28} {:>10.3}", "power button", 0.0);
+    if let Some(post) = times.first_post {
+        println!("{:<28} {:>10.3}", format!("first POST code {:04X}", post.code), since(post.time));
+    }
+    if let Some(time) = times.plt_rst {
+        println!("{:<28} {:>10.3}", "PLT_RST# de-asserted", since(time));
+    }
+    // The last POST code before the OS driver loads is the firmware handoff
+    let handoff = times.posts.iter()
+        .filter(|post| times.acpi_os.map_or(true, |os| post.time.wrapping_sub(start) <= os.wrapping_sub(start)))
+        .last();
+    if let Some(post) = handoff {
+        println!("{:<28} {:>10.3}", format!("last POST code {:04X}", post.code), since(post.time));
+    }
+    if let Some(time) = times.acpi_os {
+        println!("{:<28} {:>10.3}", "ACPI OS driver loaded", since(time));
+    }
+
+    if !times.posts.is_empty() {
+        println!();
+        println!("{:<28} {:>10}", "recent POST codes", "time s");
+        for post in times.posts.iter() {
+            println!("{:<28} {:>10.3}", format!("{:04X}", post.code), since(post.time));
+        }
+    }
+
+    Ok(())
+}
+
+unsafe fn power_trace(ec: &mut Ec<Box<dyn Access>>, clear: bool) -> Result<(), Error> {
+    // Must match enum PowerTraceId in the firmware
+    let names = [
+        "STATE", "PWR_SW#", "VA_EC_EN", "PD_EN", "DD_ON", "SUS_PWR_ACK", "PCH_DPWROK_EC",
+        "EC_RSMRST#", "EC_EN", "PWR_BTN#", "PM_PWROK", "PCH_PWROK_EC", "ALL_SYS_PWRGD",
+        "BUF_PLT_RST#", "SLP_SUS#", "SUSWARN#", "LAN_WAKEUP#",
+    ];
+    let states = ["OFF", "S5", "S3", "S0"];
+
+    let traces = ec.power_trace(clear)?;
+    let start = match traces.first() {
+        Some(trace) => trace.time,
+        None => {
+            println!("power trace is empty");
+            return Ok(());
+        },
+    };
+
+    println!("{:>12} {:>10}  signal", "time ms", "delta ms");
+    let mut last = start;
+    for trace in traces.iter() {
+        // EC time wraps, so use wrapping differences
+        let time = trace.time.wrapping_sub(start);
+        let delta = trace.time.wrapping_sub(last);
+        last = trace.time;
+
+        let name = names.get(trace.id as usize).map_or(format!("{}", trace.id), |x| x.to_string());
+        let value = if trace.id == 0 {
+            states.get(trace.value as usize).map_or(format!("{}", trace.value), |x| x.to_string())
+        } else {
+            format!("{}", trace.value)
+        };
+        println!(
+            "{:>12.3} {:>10.3}  {} = {}",
+            time as f64 / 1000.0, delta as f64 / 1000.0, name, value
+        );
+    }
+
+    Ok(())
+}
+
+unsafe fn telemetry(ec: &mut Ec<Box<dyn Access>>) -> Result<(), Error> {
+    let t = ec.telemetry()?;
+    println!("power state: {}", t.power_state);
+    println!("cpu temp: {} C", t.cpu_temp);
+    println!("dgpu temp: {} C", t.dgpu_temp);
+    for i in 0..t.fan_duty.len() {
+        println!("fan {}: duty {} tach {}", i + 1, t.fan_duty[i], t.fan_tach[i]);
+    }
+    println!("battery temp: {} dK", t.battery_temp);
+    println!("battery voltage: {} mV", t.battery_voltage);
+    println!("battery current: {} mA", t.battery_current);
+    println!("battery charge: {} %", t.battery_charge);
+    println!("battery capacity: {} / {} mAh", t.battery_remaining_capacity, t.battery_full_capacity);
+    println!("battery status: {:04X}", t.battery_status);
+    println!("battery cycles: {}", t.battery_cycle_count);
+
+    Ok(())
+}
+
 unsafe fn keymap_get(ec: &mut Ec<Box<dyn Access>>, layer: u8, output: u8, input: u8) -> Result<(), Error> {
     let value = ec.keymap_get(layer, output, input)?;
     println!("{:04X}", value);
@@ -302,7 +613,13 @@ fn main() {
             .possible_values(&["lpc-linux", "lpc-sim", "hid"])
             .default_value("lpc-linux")
         )
-        .subcommand(SubCommand::with_name("console"))
+        .subcommand(SubCommand::with_name("boot"))
+        .subcommand(SubCommand::with_name("console")
+            .arg(Arg::with_name("dictionary")
+                .long("dictionary")
+                .takes_value(true)
+            )
+        )
         .subcommand(SubCommand::with_name("fan")
             .arg(Arg::with_name("index")
                 .validator(validate_from_str::<u8>)
@@ -371,18 +688,29 @@ fn main() {
         )
         .subcommand(SubCommand::with_name("led_save"))
         .subcommand(SubCommand::with_name("matrix"))
+        .subcommand(SubCommand::with_name("power_trace")
+            .arg(Arg::with_name("clear")
+                .long("clear")
+            )
+        )
         .subcommand(SubCommand::with_name("print")
             .arg(Arg::with_name("message")
                 .required(true)
                 .multiple(true)
             )
         )
+        .subcommand(SubCommand::with_name("profile")
+            .arg(Arg::with_name("reset")
+                .long("reset")
+            )
+        )
         .subcommand(SubCommand::with_name("set_no_input")
             .arg(Arg::with_name("value")
                 .possible_values(&["true", "false"])
                 .required(true)
             )
         )
+        .subcommand(SubCommand::with_name("telemetry"))
         .get_matches();
 
     let get_ec = || -> Result<_, Error> {
@@ -431,7 +759,14 @@ fn main() {
     };
 
     match matches.subcommand() {
-        ("console", Some(_sub_m)) => match unsafe { console(&mut ec) } {
+        ("boot", Some(_sub_m)) => match unsafe { boot(&mut ec) } {
+            Ok(()) => (),
+            Err(err) => {
+                eprintln!("failed to read boot times: {:X?}", err);
+                process::exit(1);
+            },
+        },
+        ("console", Some(sub_m)) => match unsafe { console(&mut ec, sub_m.value_of("dictionary")) } {
             Ok(()) => (),
             Err(err) => {
                 eprintln!("failed to read console: {:X?}", err);
@@ -597,6 +932,13 @@ fn main() {
                 process::exit(1);
             },
         },
+        ("power_trace", Some(sub_m)) => match unsafe { power_trace(&mut ec, sub_m.is_present("clear")) } {
+            Ok(()) => (),
+            Err(err) => {
+                eprintln!("failed to read power trace: {:X?}", err);
+                process::exit(1);
+            },
+        },
         ("print", Some(sub_m)) => for arg in sub_m.values_of("message").unwrap() {
             let mut arg = arg.to_owned();
             arg.push('\n');
@@ -608,6 +950,13 @@ fn main() {
                 },
             }
         },
+        ("profile", Some(sub_m)) => match unsafe { profile(&mut ec, sub_m.is_present("reset")) } {
+            Ok(()) => (),
+            Err(err) => {
+                eprintln!("failed to read profile: {:X?}", err);
+                process::exit(1);
+            },
+        },
         ("set_no_input", Some(sub_m)) => {
             let no_input = sub_m.value_of("value").unwrap().parse::<bool>().unwrap();
             match unsafe { ec.set_no_input(no_input) } {
@@ -617,7 +966,14 @@ fn main() {
                     process::exit(1);
                 }
             }
-        }
+        },
+        ("telemetry", Some(_sub_m)) => match unsafe { telemetry(&mut ec) } {
+            Ok(()) => (),
+            Err(err) => {
+                eprintln!("failed to read telemetry: {:X?}", err);
+                process::exit(1);
+            },
+        },
         _ => unreachable!()
     }
 }
@@ -18,6 +18,32 @@ pub trait Spi {
 
     /// Write data to the SPI bus
     unsafe fn write(&mut self, data: &[u8]) -> Result<usize, Error>;
+
+    /// Calculate the CRC32 of a ROM range without reading it over the bus, if supported
+    unsafe fn crc32(&mut self, _address: u32, _length: u32) -> Result<u32, Error> {
+        Err(Error::NotSupported)
+    }
+
+    /// Program data to a ROM address without driving each instruction over the bus, if supported
+    unsafe fn program(&mut self, _address: u32, _data: &[u8]) -> Result<usize, Error> {
+        Err(Error::NotSupported)
+    }
+}
+
+/// Calculate the CRC32 (IEEE 802.3) of data, matching `Spi::crc32`
+pub fn crc32(data: &[u8]) -> u32 {
+    let mut crc = 0xFFFF_FFFF;
+    for &byte in data {
+        crc ^= byte as u32;
+        for _ in 0..8 {
+            if crc & 1 != 0 {
+                crc = (crc >> 1) ^ 0xEDB8_8320;
+            } else {
+                crc >>= 1;
+            }
+        }
+    }
+    !crc
 }
 
 /// Target which will receive SPI commands
@@ -143,12 +169,27 @@ impl<'a, S: Spi, T: Timeout> SpiRom<'a, S, T> {
         self.spi.read(data)
     }
 
+    /// Calculate the CRC32 of a range at a specific address
+    pub unsafe fn crc32_at(&mut self, address: u32, length: u32) -> Result<u32, Error> {
+        if (address & 0xFF00_0000) > 0 {
+            return Err(Error::Parameter);
+        }
+
+        self.spi.crc32(address, length)
+    }
+
     /// Write at a specific address
     pub unsafe fn write_at(&mut self, address: u32, data: &[u8]) -> Result<usize, Error> {
         if (address & 0xFF00_0000) > 0 {
             return Err(Error::Parameter);
         }
 
+        // Let the bus program the whole range if it can
+        match self.spi.program(address, data) {
+            Err(Error::NotSupported) => (),
+            result => return result,
+        }
+
         self.write_enable()?;
 
         //TODO: automatically detect write command